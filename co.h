@@ -13,6 +13,8 @@ CO_MAKE   (NAME, ...)   : ...
 
 CO_AWAIT(cogo_co_t*)    : call another coroutine.
 CO_START(cogo_co_t*)    : run a new coroutine concurrently.
+CO_AWAIT_NEW(NAME, ...) : call a new coroutine made by CO_INIT(PTR, NAME, ...) in place on the scheduler's frame stack.
+CO_AWAITED  (NAME)      : the coroutine (NAME*) finished by the last CO_AWAIT_NEW(), valid until the next CO_AWAIT_NEW() or yield.
 
 cogo_co_t               : coroutine type, should be inherited by user.
 cogo_sch_t              : sheduler  type, should be inherited by user.
@@ -20,20 +22,47 @@ cogo_sch_t              : sheduler  type, should be inherited by user.
 inline cogo_co_t* cogo_sch_step(cogo_sch_t*):
     Run the current coroutine until yield or finished, return the next coroutine to be run.
 
+COGO_SCH_STEP_DEFINE(STEP, PUSH, POP):
+    Define a step function like cogo_sch_step() with another scheduler policy, PUSH and POP are inlined.
+
 inline int cogo_sch_push(cogo_sch_t*, cogo_co_t*)   : *need to be implemented by user*
-    Push a coroutine to the running queue.
+    Push a coroutine to the running queue, the policy of cogo_sch_step().
+
+inline int cogo_sch_ready(cogo_sch_t*, cogo_co_t*):
+    Push a coroutine by the policy stepping the scheduler, e.g. wake up a coroutine blocked on a channel.
 
 inline cogo_co_t* cogo_sch_pop(cogo_sch_t*)         : *need to be implemented by user*
     Pop a coroutine to be run.
 
+COGO_PROFILE:
+    Define to profile coroutines by yield site, see co_prof.h.
+    Define it for the library and all its users, e.g. by the CMake option COGO_PROFILE.
+
+COGO_WATCHDOG:
+    Define to report the steps longer than a threshold, see co_watchdog.h.
+    Define it for the library and all its users, e.g. by the CMake option COGO_WATCHDOG.
+
+void cogo_sch_frame_free(cogo_sch_t*):
+    Release the frame stack of scheduler, should be called when scheduler finished.
+
+* Note
+- The non-static inline functions (cogo_sch_step, cogo_sch_ready, cogo_sch_frame_pop, and the helpers they call) need an external
+  definition by "extern inline" in one C file, see co_st.c.
+
 */
 #ifndef MOXITREL_COGO_CO_H_
 #define MOXITREL_COGO_CO_H_
 
 #include "yield.h"
+#include <stddef.h>
+#include <stdlib.h>
 
-typedef struct cogo_co      cogo_co_t;      // coroutine
-typedef struct cogo_sch     cogo_sch_t;     // scheduler
+typedef struct cogo_co          cogo_co_t;          // coroutine
+typedef struct cogo_sch         cogo_sch_t;         // scheduler
+typedef struct cogo_frame       cogo_frame_t;       // frame header of CO_AWAIT_NEW()
+typedef struct cogo_frame_seg   cogo_frame_seg_t;   // segment of frame stack
+typedef struct cogo_prof        cogo_prof_t;        // profiler, see co_prof.h
+typedef struct cogo_watchdog    cogo_watchdog_t;    // slow-step watchdog, see co_watchdog.h
 
 // support call stack, concurrency
 struct cogo_co {
@@ -50,12 +79,74 @@ struct cogo_co {
     cogo_sch_t* sch;
 };
 
+// frame stack alignment, power of 2
+#ifndef COGO_FRAME_ALIGN
+#   define COGO_FRAME_ALIGN     16
+#endif
+
+// size of the first segment of frame stack
+#ifndef COGO_FRAME_SEG_SIZE
+#   define COGO_FRAME_SEG_SIZE  4096
+#endif
+
+#define COGO_FRAME_ALIGN_UP(N)  (((N) + COGO_FRAME_ALIGN - 1) & ~(size_t)(COGO_FRAME_ALIGN - 1))
+
+// put before each frame allocated by CO_AWAIT_NEW()
+struct cogo_frame {
+    cogo_frame_t* prev;
+    // finished, pop when reach the stack top
+    int done;
+};
+
+struct cogo_frame_seg {
+    cogo_frame_seg_t* prev;
+    // free space [sp, end)
+    char* sp;
+    char* end;
+};
+
 // cogo_co_t scheduler
 struct cogo_sch {
     // the coroutine run by scheduler
     cogo_co_t* stack_top;
+
+    // PUSH of the step function running the scheduler, see cogo_sch_ready()
+    int (*push)(cogo_sch_t*, cogo_co_t*);
+
+    // frame stack for CO_AWAIT_NEW(), children always finish before caller resumes.
+    struct {
+        // the top segment
+        cogo_frame_seg_t* seg;
+        // an empty segment cached to avoid malloc() when push/pop across the segment boundary
+        cogo_frame_seg_t* spare;
+        // the top frame
+        cogo_frame_t* top;
+        // the frame finished last, see CO_AWAITED()
+        void* last;
+    } frame;
+
+    // profile data, not profiled if NULL, used only if COGO_PROFILE defined (kept for the same layout in all builds)
+    cogo_prof_t* prof;
+    // not watched if NULL, used only if COGO_WATCHDOG defined
+    cogo_watchdog_t* watchdog;
 };
 
+// COGO_SCH_CALL(SCH): call the stack top in cogo_sch_step(), wrapped by the watchdog, then the profiler
+#ifdef COGO_PROFILE
+#   include "co_prof.h"
+#   undef  COGO_ON_BEGIN
+#   define COGO_ON_BEGIN            cogo_prof_begin((cogo_co_t*)(CO_THIS), __func__, __FILE__);
+#   define COGO_SCH_CALL_PROF(SCH)  cogo_prof_call(SCH)
+#else
+#   define COGO_SCH_CALL_PROF(SCH)  (SCH)->stack_top->func((SCH)->stack_top)
+#endif
+#ifdef COGO_WATCHDOG
+#   include "co_watchdog.h"
+#   define COGO_SCH_CALL(SCH)       cogo_watchdog_call(SCH)
+#else
+#   define COGO_SCH_CALL(SCH)       COGO_SCH_CALL_PROF(SCH)
+#endif
+
 // push coroutine into the concurrent queue
 // switch context if return !0
 inline int cogo_sch_push(cogo_sch_t*, cogo_co_t*);
@@ -87,10 +178,143 @@ static inline void cogo_co_await(cogo_co_t* thiz, cogo_co_t* callee)
     thiz->sch->stack_top = callee;
 }
 
+// frames begin at seg + COGO_FRAME_ALIGN_UP(sizeof(cogo_frame_seg_t))
+#define COGO_FRAME_SEG_BEGIN(SEG)   ((char*)(SEG) + COGO_FRAME_ALIGN_UP(sizeof(cogo_frame_seg_t)))
+
+// CO_AWAIT_NEW(NAME, ...): make a coroutine with CO_INIT(PTR, NAME, ...) in place on the frame stack, and call it,
+// designated initializers only. The frame is popped automatically when it returns, read the result by
+// CO_AWAITED(NAME). If out of memory, the await is skipped and CO_AWAITED(NAME) is NULL.
+#define CO_AWAIT_NEW(NAME, ...)                                                                     \
+do {                                                                                                \
+    {                                                                                               \
+        void* cogo_new = cogo_sch_frame_push(((cogo_co_t*)(CO_THIS))->sch, sizeof(NAME));           \
+        if (!cogo_new) {                                                                            \
+            ((cogo_co_t*)(CO_THIS))->sch->frame.last = NULL;                                        \
+            break;                                                                                  \
+        }                                                                                           \
+        CO_INIT(cogo_new, NAME, __VA_ARGS__);                                                       \
+        cogo_co_await((cogo_co_t*)(CO_THIS), (cogo_co_t*)cogo_new);                                 \
+    }                                                                                               \
+    CO_YIELD;                                                                                       \
+} while (0)
+
+// CO_AWAITED(NAME): the coroutine finished by the last CO_AWAIT_NEW().
+#define CO_AWAITED(NAME)        ((NAME*)((cogo_co_t*)(CO_THIS))->sch->frame.last)
+
+// allocate size bytes on the top of frame stack
+static inline void* cogo_sch_frame_push(cogo_sch_t* sch, size_t size)
+{
+    COGO_ASSERT(sch);
+
+    size_t need = COGO_FRAME_ALIGN_UP(sizeof(cogo_frame_t)) + COGO_FRAME_ALIGN_UP(size);
+    cogo_frame_seg_t* seg = sch->frame.seg;
+    if (!seg || (size_t)(seg->end - seg->sp) < need) {
+        // grow a new segment, at least double the previous one
+        size_t cap = seg ? 2 * (size_t)(seg->end - COGO_FRAME_SEG_BEGIN(seg)) : COGO_FRAME_SEG_SIZE;
+        if (cap < need) {
+            cap = need;
+        }
+        seg = sch->frame.spare;
+        sch->frame.spare = NULL;
+        if (!seg || (size_t)(seg->end - COGO_FRAME_SEG_BEGIN(seg)) < need) {
+            free(seg);
+            seg = (cogo_frame_seg_t*)malloc(COGO_FRAME_ALIGN_UP(sizeof(cogo_frame_seg_t)) + cap);
+            COGO_ASSERT(seg);
+            if (!seg) {
+                return NULL;
+            }
+            seg->end = COGO_FRAME_SEG_BEGIN(seg) + cap;
+        }
+        seg->sp = COGO_FRAME_SEG_BEGIN(seg);
+        seg->prev = sch->frame.seg;
+        sch->frame.seg = seg;
+    }
+
+    cogo_frame_t* frame = (cogo_frame_t*)seg->sp;
+    seg->sp += need;
+    frame->prev = sch->frame.top;
+    frame->done = 0;
+    sch->frame.top = frame;
+    return (char*)frame + COGO_FRAME_ALIGN_UP(sizeof(cogo_frame_t));
+}
+
+// mark the finished coroutine popped if it's a frame of CO_AWAIT_NEW(), release the frames on top.
+inline void cogo_sch_frame_pop(cogo_sch_t* sch, cogo_co_t* co)
+{
+    COGO_ASSERT(sch);
+    COGO_ASSERT(co);
+
+    cogo_frame_seg_t* seg = sch->frame.seg;
+    while (seg && !((char*)co >= COGO_FRAME_SEG_BEGIN(seg) && (char*)co < seg->sp)) {
+        seg = seg->prev;
+    }
+    if (!seg) {
+        // not on the frame stack
+        return;
+    }
+    // Frames of a segment are contiguous, the top ones first. Skip the frames of newer segments and those above
+    // co, co is a frame only if it starts the next one, not a coroutine embedded in it.
+    char* at = (char*)co - COGO_FRAME_ALIGN_UP(sizeof(cogo_frame_t));
+    cogo_frame_t* frame = sch->frame.top;
+    while (frame && !((char*)frame >= COGO_FRAME_SEG_BEGIN(seg) && (char*)frame < seg->sp)) {
+        frame = frame->prev;
+    }
+    while (frame && (char*)frame > at) {
+        frame = frame->prev;
+    }
+    if ((char*)frame != at) {
+        return;
+    }
+    frame->done = 1;
+    sch->frame.last = co;
+
+    // frames may be finished out of order by concurrent coroutines, pop all finished on top.
+    while (sch->frame.top && sch->frame.top->done) {
+        seg = sch->frame.seg;
+        seg->sp = (char*)sch->frame.top;
+        sch->frame.top = sch->frame.top->prev;
+        if (seg->sp == COGO_FRAME_SEG_BEGIN(seg)) {
+            // empty, the one holds the last frame is kept as spare
+            sch->frame.seg = seg->prev;
+            if (!sch->frame.spare) {
+                sch->frame.spare = seg;
+            } else if ((char*)co >= COGO_FRAME_SEG_BEGIN(seg) && (char*)co < seg->end) {
+                free(sch->frame.spare);
+                sch->frame.spare = seg;
+            } else {
+                free(seg);
+            }
+        }
+    }
+}
+
+static inline void cogo_sch_frame_free(cogo_sch_t* sch)
+{
+    COGO_ASSERT(sch);
+    while (sch->frame.seg) {
+        cogo_frame_seg_t* prev = sch->frame.seg->prev;
+        free(sch->frame.seg);
+        sch->frame.seg = prev;
+    }
+    free(sch->frame.spare);
+    sch->frame.spare = NULL;
+    sch->frame.top = NULL;
+    sch->frame.last = NULL;
+}
+
+// Push a coroutine by the policy stepping the scheduler, for the code that doesn't know the policy
+// (CO_START, wakeups of channels ...), an indirect call as it's not on the path of each step.
+// By cogo_sch_push() if never stepped.
+inline int cogo_sch_ready(cogo_sch_t* sch, cogo_co_t* co)
+{
+    COGO_ASSERT(sch);
+    return sch->push ? sch->push(sch, co) : cogo_sch_push(sch, co);
+}
+
 // CO_START(cogo_co_t*): add a new coroutine to the scheduler.
 #define CO_START(CO)                                                            \
 do {                                                                            \
-    if (cogo_sch_push(((cogo_co_t*)(CO_THIS))->sch, (cogo_co_t*)(CO)) != 0) {   \
+    if (cogo_sch_ready(((cogo_co_t*)(CO_THIS))->sch, (cogo_co_t*)(CO)) != 0) {  \
         CO_YIELD;                                                               \
     }                                                                           \
 } while (0)
@@ -99,37 +323,51 @@ do {
 // cogo_sch_t
 //
 
-// run the coroutine in stack top until yield or finished, return the next coroutine to be run.
-inline cogo_co_t* cogo_sch_step(cogo_sch_t* sch)
-{
-    COGO_ASSERT(sch);
-    while (sch->stack_top) {
-        sch->stack_top->sch = sch;
-        sch->stack_top->func(sch->stack_top);
-        if (!sch->stack_top) {
-            // blocked
-            break;
-        }
-        if (CO_STATE(sch->stack_top) > 0) {
-            // yield
-            cogo_sch_push(sch, sch->stack_top);
-            break;
-        }
-        if (CO_STATE(sch->stack_top) == 0) {
-            // await
-            continue;
-        }
-        if (CO_STATE(sch->stack_top) == -1) {
-            // return
-            sch->stack_top = sch->stack_top->caller;
-            continue;
-        }
-        COGO_ASSERT(((void)"ImpossibleCase",0));
-        break;  // discard the coroutine
-    }
-    return sch->stack_top = cogo_sch_pop(sch);
+// COGO_SCH_STEP_DEFINE(STEP, PUSH, POP): define the step function "cogo_co_t* STEP(cogo_sch_t*)" of a scheduler policy.
+// PUSH, POP: functions with the same signatures as cogo_sch_push(), cogo_sch_pop(), called directly to be inlined
+// in the step loop. PUSH is also kept in cogo_sch_t.push for CO_START and wakeups by the coroutines it runs.
+// Several policies can live in one binary.
+//
+// e.g. static inline COGO_SCH_STEP_DEFINE(lifo_step, lifo_push, lifo_pop)
+#define COGO_SCH_STEP_DEFINE(STEP, PUSH, POP)                                   \
+cogo_co_t* STEP(cogo_sch_t* sch)                                                \
+{                                                                               \
+    COGO_ASSERT(sch);                                                           \
+    sch->push = PUSH;                                                           \
+    while (sch->stack_top) {                                                    \
+        sch->stack_top->sch = sch;                                              \
+        COGO_SCH_CALL(sch);                                                     \
+        if (!sch->stack_top) {                                                  \
+            /* blocked */                                                       \
+            break;                                                              \
+        }                                                                       \
+        if (CO_STATE(sch->stack_top) > 0) {                                     \
+            /* yield */                                                         \
+            PUSH(sch, sch->stack_top);                                          \
+            break;                                                              \
+        }                                                                       \
+        if (CO_STATE(sch->stack_top) == 0) {                                    \
+            /* await */                                                         \
+            continue;                                                           \
+        }                                                                       \
+        if (CO_STATE(sch->stack_top) == -1) {                                   \
+            /* return */                                                        \
+            cogo_co_t* callee = sch->stack_top;                                 \
+            sch->stack_top = callee->caller;                                    \
+            if (sch->frame.top) {                                               \
+                cogo_sch_frame_pop(sch, callee);                                \
+            }                                                                   \
+            continue;                                                           \
+        }                                                                       \
+        COGO_ASSERT(((void)"ImpossibleCase",0));                                \
+        break;  /* discard the coroutine */                                     \
+    }                                                                           \
+    return sch->stack_top = POP(sch);                                           \
 }
 
+// run the coroutine in stack top until yield or finished, return the next coroutine to be run.
+inline COGO_SCH_STEP_DEFINE(cogo_sch_step, cogo_sch_push, cogo_sch_pop)
+
 #undef CO_DECLARE
 #define CO_DECLARE(NAME, ...)                                   \
     COGO_DECLARE(NAME, cogo_co_t cogo_co, __VA_ARGS__)
@@ -141,4 +379,8 @@ inline cogo_co_t* cogo_sch_step(cogo_sch_t* sch)
         __VA_ARGS__                                             \
     })
 
+#undef COGO_INIT_FUNC
+#define COGO_INIT_FUNC(NAME)                                    \
+    .cogo_co.func = NAME##_func
+
 #endif // MOXITREL_COGO_CO_H_
@@ -0,0 +1,4 @@
+#include "co_bcast.h"
+
+extern inline int cogo_bcast_write(co_t* co, co_bcast_t* bcast, co_msg_t* msg);
+extern inline int cogo_bcast_read(co_t* co, co_bcast_sub_t* sub, co_msg_t** pmsg);
@@ -0,0 +1,184 @@
+/*
+
+* API
+co_bcast_t                                          : broadcast channel type
+co_bcast_sub_t                                      : subscriber type, keeps a cursor into the channel
+CO_BCAST_MAKE (co_msg_t*[], size_t, int)            : return a broadcast channel over a ring of size_t (power of 2) message pointers,
+                                                      with the lag policy CO_BCAST_BLOCK or CO_BCAST_DROP
+co_bcast_subscribe  (co_bcast_t*, co_bcast_sub_t*)  : add a subscriber, it receives messages published from now on
+co_bcast_unsubscribe(co_bcast_t*, co_bcast_sub_t*)  : remove a subscriber
+CO_BCAST_WRITE(co_bcast_t*, co_msg_t*)              : publish a message to all subscribers
+CO_BCAST_READ (co_bcast_sub_t*, co_msg_t**)         : receive the next message
+
+* Note
+- Messages are shared by pointer, co_msg_t.next is never touched. A message may sit in several channels at once,
+  and must stay alive until all subscribers have read it (or it's dropped).
+- A slow subscriber lags behind at most size_t messages:
+    CO_BCAST_BLOCK: the publisher blocks until the slowest subscriber catches up.
+    CO_BCAST_DROP : the oldest messages are overwritten, the subscriber skips them and counts in co_bcast_sub_t.dropped.
+
+*/
+#ifndef MOXITREL_COGO_CO_BCAST_H_
+#define MOXITREL_COGO_CO_BCAST_H_
+
+#include "co_st.h"
+
+// lag policy
+#define CO_BCAST_BLOCK  0
+#define CO_BCAST_DROP   1
+
+typedef struct co_bcast     co_bcast_t;
+typedef struct co_bcast_sub co_bcast_sub_t;
+
+struct co_bcast_sub {
+    // the subscribed channel
+    co_bcast_t* bcast;
+    // build subscriber list
+    co_bcast_sub_t* next;
+    // sequence of the next message to be read
+    size_t pos;
+    // number of messages skipped (CO_BCAST_DROP)
+    size_t dropped;
+};
+
+struct co_bcast {
+    // ring of published messages, indexed by sequence & mask
+    co_msg_t** const ring;
+    const size_t mask;
+    // lag policy
+    const int policy;
+    // sequence of the next message to be published
+    size_t head;
+    // cached min pos of all subscribers (CO_BCAST_BLOCK)
+    size_t tail;
+    // all subscribers
+    co_bcast_sub_t* subs;
+    // readers blocked by this channel
+    co_queue_t rq;
+    // writers blocked by this channel
+    co_queue_t wq;
+};
+
+#define CO_BCAST_MAKE(RING, N, POLICY)   ((co_bcast_t){.ring = (RING), .mask = (N) - 1, .policy = (POLICY),})
+
+static inline void co_bcast_subscribe(co_bcast_t* bcast, co_bcast_sub_t* sub)
+{
+    COGO_ASSERT(bcast);
+    COGO_ASSERT(((bcast->mask + 1) & bcast->mask) == 0);    // power of 2
+    COGO_ASSERT(sub);
+
+    if (!bcast->subs) {
+        bcast->tail = bcast->head;
+    }
+    sub->bcast = bcast;
+    sub->pos = bcast->head;
+    sub->dropped = 0;
+    sub->next = bcast->subs;
+    bcast->subs = sub;
+}
+
+// wake up all coroutines in queue q, in one pass
+static inline void cogo_bcast_wake(co_queue_t* q, cogo_sch_t* sch)
+{
+    co_t* co;
+    while ((co = (co_t*)co_queue_pop(q, offsetof(co_t, next))) != NULL) {
+        cogo_sch_ready(sch, (cogo_co_t*)co);
+    }
+}
+
+static inline void co_bcast_unsubscribe(co_bcast_t* bcast, co_bcast_sub_t* sub)
+{
+    COGO_ASSERT(bcast);
+    COGO_ASSERT(sub);
+    COGO_ASSERT(sub->bcast == bcast);
+
+    for (co_bcast_sub_t** p = &bcast->subs; *p; p = &(*p)->next) {
+        if (*p == sub) {
+            *p = sub->next;
+            break;
+        }
+    }
+    sub->bcast = NULL;
+    // the slowest subscriber may be gone, let the blocked writers retry.
+    // NOTE: a blocked writer implies a running scheduler in the current thread.
+    if (!co_queue_empty(&bcast->wq)) {
+        cogo_bcast_wake(&bcast->wq, ((cogo_co_t*)bcast->wq.head)->sch);
+    }
+}
+
+// CO_BCAST_WRITE(co_bcast_t*, co_msg_t*);
+// Publish won't switch context unless blocked, a burst of messages can be published in one step.
+#define CO_BCAST_WRITE(BCAST, MSG)                                                                  \
+do {                                                                                                \
+    while (cogo_bcast_write((co_t*)(CO_THIS), (BCAST), (co_msg_t*)(MSG)) != 0) {                    \
+        CO_YIELD;                                                                                   \
+    }                                                                                               \
+} while (0)
+// return !0 if blocked, should be retried when resumed
+inline int cogo_bcast_write(co_t* co, co_bcast_t* bcast, co_msg_t* msg)
+{
+//  COGO_ASSERT(co);
+    COGO_ASSERT(bcast);
+    COGO_ASSERT(msg);
+
+    if (bcast->policy == CO_BCAST_BLOCK && bcast->head - bcast->tail > bcast->mask) {
+        // the cached tail is stale at most, find the slowest subscriber
+        size_t tail = bcast->head;
+        for (const co_bcast_sub_t* sub = bcast->subs; sub; sub = sub->next) {
+            if (bcast->head - sub->pos > bcast->head - tail) {
+                tail = sub->pos;
+            }
+        }
+        bcast->tail = tail;
+        if (bcast->head - tail > bcast->mask) {
+            // sleep in background
+            co_queue_push(&bcast->wq, offsetof(co_t, next), co);
+            ((cogo_co_t*)co)->sch->stack_top = NULL;
+            return 1;
+        }
+    }
+    bcast->ring[bcast->head & bcast->mask] = msg;
+    bcast->head++;
+    // wake up all readers
+    cogo_bcast_wake(&bcast->rq, ((cogo_co_t*)co)->sch);
+    return 0;
+}
+
+// CO_BCAST_READ(co_bcast_sub_t*, co_msg_t**);
+#define CO_BCAST_READ(SUB, PMSG)                                                                    \
+do {                                                                                                \
+    while (cogo_bcast_read((co_t*)(CO_THIS), (SUB), (PMSG)) != 0) {                                 \
+        CO_YIELD;                                                                                   \
+    }                                                                                               \
+} while (0)
+// return !0 if blocked, should be retried when resumed
+inline int cogo_bcast_read(co_t* co, co_bcast_sub_t* sub, co_msg_t** pmsg)
+{
+//  COGO_ASSERT(co);
+    COGO_ASSERT(sub);
+    COGO_ASSERT(sub->bcast);
+    COGO_ASSERT(pmsg);
+
+    co_bcast_t* bcast = sub->bcast;
+    size_t lag = bcast->head - sub->pos;
+    if (lag == 0) {
+        // sleep in background
+        co_queue_push(&bcast->rq, offsetof(co_t, next), co);
+        ((cogo_co_t*)co)->sch->stack_top = NULL;
+        return 1;
+    }
+    if (lag > bcast->mask) {
+        // overwritten (CO_BCAST_DROP), skip to the oldest one in ring
+        COGO_ASSERT(bcast->policy == CO_BCAST_DROP || lag == bcast->mask + 1);
+        sub->dropped += lag - (bcast->mask + 1);
+        sub->pos = bcast->head - (bcast->mask + 1);
+    }
+    *pmsg = bcast->ring[sub->pos & bcast->mask];
+    // wake up the writers if the slowest one moves on
+    if (sub->pos++ == bcast->tail && !co_queue_empty(&bcast->wq)) {
+        cogo_bcast_wake(&bcast->wq, ((cogo_co_t*)co)->sch);
+    }
+    return 0;
+}
+
+#endif // MOXITREL_COGO_CO_BCAST_H_
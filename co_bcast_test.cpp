@@ -0,0 +1,96 @@
+#include <assert.h>
+#include "co_bcast.h"
+#include "gtest/gtest.h"
+
+CO_DECLARE(static Sub, co_bcast_sub_t sub, int n, co_msg_t* got[8])
+{
+    auto* thiz = (Sub*)CO_THIS;
+CO_BEGIN:
+
+    for (thiz->n = 0; thiz->n < 8; thiz->n++) {
+        CO_BCAST_READ(&thiz->sub, &thiz->got[thiz->n]);
+    }
+
+CO_END:;
+}
+
+CO_DECLARE(static Pub, co_bcast_t* bcast, co_msg_t* msgs, int n)
+{
+    auto* thiz = (Pub*)CO_THIS;
+CO_BEGIN:
+
+    for (thiz->n = 0; thiz->n < 8; thiz->n++) {
+        CO_BCAST_WRITE(thiz->bcast, &thiz->msgs[thiz->n]);
+    }
+
+CO_END:;
+}
+
+CO_DECLARE(static Entry, Sub sub1, Sub sub2, Pub pub)
+{
+    auto* thiz = (Entry*)CO_THIS;
+CO_BEGIN:
+
+    CO_START(&thiz->sub1);
+    CO_START(&thiz->sub2);
+    CO_START(&thiz->pub);
+
+CO_END:;
+}
+
+TEST(Bcast, FanOut)
+{
+    co_msg_t* ring[2];
+    co_msg_t msgs[8];
+    auto b0 = CO_BCAST_MAKE(ring, 2, CO_BCAST_BLOCK);
+    auto entry = CO_MAKE(Entry, CO_MAKE(Sub), CO_MAKE(Sub), CO_MAKE(Pub, &b0, msgs));
+    co_bcast_subscribe(&b0, &entry.sub1.sub);
+    co_bcast_subscribe(&b0, &entry.sub2.sub);
+
+    co_run(&entry);
+    EXPECT_EQ(CO_STATE(&entry.pub), -1);
+    EXPECT_EQ(CO_STATE(&entry.sub1), -1);
+    EXPECT_EQ(CO_STATE(&entry.sub2), -1);
+    for (int i = 0; i < 8; i++) {
+        EXPECT_EQ(entry.sub1.got[i], &msgs[i]);
+        EXPECT_EQ(entry.sub2.got[i], &msgs[i]);
+    }
+    EXPECT_EQ(entry.sub1.sub.dropped, 0u);
+}
+
+CO_DECLARE(static Lag, Pub pub, Sub sub)
+{
+    auto* thiz = (Lag*)CO_THIS;
+CO_BEGIN:
+
+    CO_AWAIT(&thiz->pub);   // publish all before reading
+    CO_AWAIT(&thiz->sub);
+
+CO_END:;
+}
+
+TEST(Bcast, DropOldest)
+{
+    co_msg_t* ring[4];
+    co_msg_t msgs[12];
+    auto b0 = CO_BCAST_MAKE(ring, 4, CO_BCAST_DROP);
+    auto lag = CO_MAKE(Lag, CO_MAKE(Pub, &b0, msgs), CO_MAKE(Sub));
+    auto pub2 = CO_MAKE(Pub, &b0, msgs + 4);
+    co_bcast_subscribe(&b0, &lag.sub.sub);
+
+    co_run(&lag);
+    EXPECT_GT(CO_STATE(&lag.sub), 0);   // blocked after 4 messages
+    EXPECT_EQ(lag.sub.sub.dropped, 4u);
+    EXPECT_EQ(lag.sub.n, 4);
+    for (int i = 0; i < 4; i++) {
+        EXPECT_EQ(lag.sub.got[i], &msgs[4 + i]);
+    }
+
+    // wake up the blocked subscriber
+    co_run(&pub2);
+    EXPECT_EQ(CO_STATE(&lag.sub), -1);
+    EXPECT_EQ(lag.sub.sub.dropped, 8u);
+    for (int i = 4; i < 8; i++) {
+        EXPECT_EQ(lag.sub.got[i], &msgs[4 + i]);
+    }
+}
@@ -0,0 +1,258 @@
+/* Stackful coroutine (fiber) run by the stackless scheduler, for call paths can't be turned into CO_YIELD, e.g. callbacks.
+
+* API
+co_fiber_t                                              : fiber type, inherit co_t
+co_fiber_init      (co_fiber_t*, entry, void*, size_t)  : map a stack of size_t bytes, run entry(co_fiber_t*, void*) when started
+co_fiber_destroy   (co_fiber_t*)                        : unmap the stack
+co_fiber_yield     (co_fiber_t*)                        : CO_YIELD
+co_fiber_await     (co_fiber_t*, cogo_co_t*)            : CO_AWAIT
+co_fiber_chan_read (co_fiber_t*, co_chan_t*, co_msg_t*) : CO_CHAN_READ
+co_fiber_chan_write(co_fiber_t*, co_chan_t*, co_msg_t*) : CO_CHAN_WRITE
+
+* Example
+static void parse(co_fiber_t* fiber, void* chan)
+{
+    co_msg_t msg;
+    co_fiber_chan_read(fiber, (co_chan_t*)chan, &msg);  // block on channel
+    ...                                                 // deep calls, may yield anywhere
+}
+
+co_fiber_t fiber;
+co_fiber_init(&fiber, parse, &chan, 0);                 // default stack size
+CO_START(&fiber);                                       // run as any coroutine, or co_run(&fiber)
+...
+co_fiber_destroy(&fiber);                               // after finished
+
+* Note
+- Only the API above switches, called from the fiber itself, i.e. inside entry().
+- The stack is mmap()ed with a guard page below, a stack overflow gets SIGSEGV.
+- The context switch saves callee-saved registers only, x86-64 and aarch64 supported.
+- Sanitizers (ASan) aren't told about the stack switch.
+- Return 0 on success, or -1 with errno set.
+
+*/
+#ifndef MOXITREL_COGO_CO_FIBER_H_
+#define MOXITREL_COGO_CO_FIBER_H_
+
+#include "co_st.h"
+#include <errno.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#if !defined(__x86_64__) && !defined(__aarch64__)
+#   error "co_fiber.h: x86-64 or aarch64 only"
+#endif
+
+// default stack size
+#ifndef COGO_FIBER_STACK_SIZE
+#   define COGO_FIBER_STACK_SIZE    (64 * 1024)
+#endif
+
+typedef struct co_fiber co_fiber_t;
+
+struct co_fiber {
+    // inherit co_t
+    co_t co;
+    void (*entry)(co_fiber_t*, void*);
+    void* arg;
+    // mapped stack, the guard page included
+    void* stack;
+    size_t stack_size;
+    // saved stack pointers of the fiber and the scheduler
+    void* sp;
+    void* sch_sp;
+};
+
+// cogo_fiber_switch(void** save, void* to): save callee-saved registers and sp to *save, restore them from to.
+// cogo_fiber_boot: the first return address of a fiber, call the entry function saved in callee-saved registers.
+#if defined(__x86_64__)
+__attribute__((naked, unused)) static void cogo_fiber_switch(void** save __attribute__((unused)), void* to __attribute__((unused)))
+{
+    __asm__ __volatile__(
+        "pushq  %rbp\n\t"
+        "pushq  %rbx\n\t"
+        "pushq  %r12\n\t"
+        "pushq  %r13\n\t"
+        "pushq  %r14\n\t"
+        "pushq  %r15\n\t"
+        "movq   %rsp, (%rdi)\n\t"
+        "movq   %rsi, %rsp\n\t"
+        "popq   %r15\n\t"
+        "popq   %r14\n\t"
+        "popq   %r13\n\t"
+        "popq   %r12\n\t"
+        "popq   %rbx\n\t"
+        "popq   %rbp\n\t"
+        "retq\n\t"
+    );
+}
+
+// rbx: the fiber, r12: cogo_fiber_main
+__attribute__((naked, unused)) static void cogo_fiber_boot(void)
+{
+    __asm__ __volatile__(
+        "movq   %rbx, %rdi\n\t"
+        "callq  *%r12\n\t"
+        "ud2\n\t"
+    );
+}
+
+// saved registers: r15 r14 r13 r12 rbx rbp, return address
+#define COGO_FIBER_FRAME            9   // 7 slots, the rest for alignment
+#define COGO_FIBER_SLOT_FIBER       4   // rbx
+#define COGO_FIBER_SLOT_MAIN        3   // r12
+#define COGO_FIBER_SLOT_RETURN      6
+
+#elif defined(__aarch64__)
+__attribute__((naked, unused)) static void cogo_fiber_switch(void** save __attribute__((unused)), void* to __attribute__((unused)))
+{
+    __asm__ __volatile__(
+        "sub    sp, sp, #160\n\t"
+        "stp    x19, x20, [sp, #0]\n\t"
+        "stp    x21, x22, [sp, #16]\n\t"
+        "stp    x23, x24, [sp, #32]\n\t"
+        "stp    x25, x26, [sp, #48]\n\t"
+        "stp    x27, x28, [sp, #64]\n\t"
+        "stp    x29, x30, [sp, #80]\n\t"
+        "stp    d8,  d9,  [sp, #96]\n\t"
+        "stp    d10, d11, [sp, #112]\n\t"
+        "stp    d12, d13, [sp, #128]\n\t"
+        "stp    d14, d15, [sp, #144]\n\t"
+        "mov    x2, sp\n\t"
+        "str    x2, [x0]\n\t"
+        "mov    sp, x1\n\t"
+        "ldp    x19, x20, [sp, #0]\n\t"
+        "ldp    x21, x22, [sp, #16]\n\t"
+        "ldp    x23, x24, [sp, #32]\n\t"
+        "ldp    x25, x26, [sp, #48]\n\t"
+        "ldp    x27, x28, [sp, #64]\n\t"
+        "ldp    x29, x30, [sp, #80]\n\t"
+        "ldp    d8,  d9,  [sp, #96]\n\t"
+        "ldp    d10, d11, [sp, #112]\n\t"
+        "ldp    d12, d13, [sp, #128]\n\t"
+        "ldp    d14, d15, [sp, #144]\n\t"
+        "add    sp, sp, #160\n\t"
+        "ret\n\t"
+    );
+}
+
+// x19: the fiber, x20: cogo_fiber_main
+__attribute__((naked, unused)) static void cogo_fiber_boot(void)
+{
+    __asm__ __volatile__(
+        "mov    x0, x19\n\t"
+        "blr    x20\n\t"
+        "brk    #0\n\t"
+    );
+}
+
+// saved registers: x19 ... x30, d8 ... d15
+#define COGO_FIBER_FRAME            20
+#define COGO_FIBER_SLOT_FIBER       0   // x19
+#define COGO_FIBER_SLOT_MAIN        1   // x20
+#define COGO_FIBER_SLOT_RETURN      11  // x30
+#endif
+
+// back to the scheduler
+static inline void cogo_fiber_suspend(co_fiber_t* fiber)
+{
+    cogo_fiber_switch(&fiber->sp, fiber->sch_sp);
+}
+
+static inline void cogo_fiber_main(co_fiber_t* fiber)
+{
+    fiber->entry(fiber, fiber->arg);
+    CO_STATE(fiber) = -1;
+    cogo_fiber_suspend(fiber);
+}
+
+// cogo_co_t.func of fibers, run the fiber until it switches back
+static inline void co_fiber_func(void* co)
+{
+    co_fiber_t* fiber = (co_fiber_t*)co;
+    if (CO_STATE(fiber) == -1) {
+        return;
+    }
+    CO_STATE(fiber) = 1;    // running
+    cogo_fiber_switch(&fiber->sch_sp, fiber->sp);
+}
+
+static inline int co_fiber_init(co_fiber_t* fiber, void (*entry)(co_fiber_t*, void*), void* arg, size_t stack_size)
+{
+    COGO_ASSERT(fiber);
+    COGO_ASSERT(entry);
+
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    stack_size = ((stack_size ? stack_size : COGO_FIBER_STACK_SIZE) + page - 1) / page * page + page;
+    void* stack = mmap(NULL, stack_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0);
+    if (stack == MAP_FAILED) {
+        return -1;
+    }
+    // guard page
+    if (mprotect(stack, page, PROT_NONE) != 0) {
+        int err = errno;
+        munmap(stack, stack_size);
+        errno = err;
+        return -1;
+    }
+
+    *fiber = (co_fiber_t){
+        .co = {.cogo_co = {.func = co_fiber_func}},
+        .entry = entry,
+        .arg = arg,
+        .stack = stack,
+        .stack_size = stack_size,
+    };
+    // the frame restored by the first switch, returns to cogo_fiber_boot with sp aligned by 16
+    void** sp = (void**)((uintptr_t)((char*)stack + stack_size) & ~(uintptr_t)15) - COGO_FIBER_FRAME;
+    for (int i = 0; i < COGO_FIBER_FRAME; i++) {
+        sp[i] = NULL;
+    }
+    sp[COGO_FIBER_SLOT_FIBER] = fiber;
+    sp[COGO_FIBER_SLOT_MAIN] = (void*)(uintptr_t)&cogo_fiber_main;
+    sp[COGO_FIBER_SLOT_RETURN] = (void*)(uintptr_t)&cogo_fiber_boot;
+    fiber->sp = sp;
+    return 0;
+}
+
+static inline void co_fiber_destroy(co_fiber_t* fiber)
+{
+    COGO_ASSERT(fiber);
+    if (fiber->stack) {
+        munmap(fiber->stack, fiber->stack_size);
+        fiber->stack = NULL;
+    }
+}
+
+static inline void co_fiber_yield(co_fiber_t* fiber)
+{
+    COGO_ASSERT(fiber);
+    cogo_fiber_suspend(fiber);
+}
+
+// resumed after the callee finished
+static inline void co_fiber_await(co_fiber_t* fiber, void* callee)
+{
+    COGO_ASSERT(fiber);
+    cogo_co_await((cogo_co_t*)fiber, (cogo_co_t*)callee);
+    cogo_fiber_suspend(fiber);
+}
+
+static inline void co_fiber_chan_read(co_fiber_t* fiber, co_chan_t* chan, co_msg_t* msg_next)
+{
+    COGO_ASSERT(fiber);
+    if (cogo_chan_read((co_t*)fiber, chan, msg_next) != 0) {
+        cogo_fiber_suspend(fiber);
+    }
+}
+
+static inline void co_fiber_chan_write(co_fiber_t* fiber, co_chan_t* chan, co_msg_t* msg)
+{
+    COGO_ASSERT(fiber);
+    if (cogo_chan_write((co_t*)fiber, chan, msg) != 0) {
+        cogo_fiber_suspend(fiber);
+    }
+}
+
+#endif // MOXITREL_COGO_CO_FIBER_H_
@@ -0,0 +1,176 @@
+#include "co_fiber.h"
+#include "gtest/gtest.h"
+#include <string>
+
+static std::string trace;
+
+// deep native stack, yield from the bottom
+static int deep(co_fiber_t* fiber, int n)
+{
+    volatile char pad[64] = {};
+    if (n == 0) {
+        for (int i = 0; i < 3; i++) {
+            trace += 'f';
+            co_fiber_yield(fiber);
+        }
+        return pad[0];
+    }
+    return deep(fiber, n - 1) + pad[0] + 1;
+}
+
+static void run_deep(co_fiber_t* fiber, void* arg)
+{
+    *(int*)arg = deep(fiber, 200);
+}
+
+CO_DECLARE(static Tick)
+{
+CO_BEGIN:
+
+    trace += 't';
+    CO_YIELD;
+    trace += 't';
+    CO_YIELD;
+    trace += 't';
+
+CO_END:;
+}
+
+CO_DECLARE(static Entry, co_fiber_t* fiber, Tick tick)
+{
+CO_BEGIN:
+
+    CO_START(((Entry*)CO_THIS)->fiber);
+    CO_START(&((Entry*)CO_THIS)->tick);
+
+CO_END:;
+}
+
+TEST(Fiber, Yield)
+{
+    trace.clear();
+    int depth = 0;
+    co_fiber_t fiber;
+    ASSERT_EQ(co_fiber_init(&fiber, run_deep, &depth, 0), 0);
+    auto entry = CO_MAKE(Entry, &fiber, CO_MAKE(Tick));
+    co_run(&entry);
+
+    EXPECT_EQ(trace, "fftftt");
+    EXPECT_EQ(depth, 200);
+    EXPECT_EQ(CO_STATE(&fiber), -1);
+    co_fiber_destroy(&fiber);
+}
+
+CO_DECLARE(static Add, int a, int b, int sum)
+{
+CO_BEGIN:
+
+    CO_YIELD;
+    ((Add*)CO_THIS)->sum = ((Add*)CO_THIS)->a + ((Add*)CO_THIS)->b;
+
+CO_END:;
+}
+
+static void run_await(co_fiber_t* fiber, void* arg)
+{
+    auto add = CO_MAKE(Add, 1, 2);
+    co_fiber_await(fiber, &add);
+    *(int*)arg = add.sum;
+}
+
+TEST(Fiber, Await)
+{
+    int sum = 0;
+    co_fiber_t fiber;
+    ASSERT_EQ(co_fiber_init(&fiber, run_await, &sum, 0), 0);
+    co_run(&fiber);
+
+    EXPECT_EQ(sum, 3);
+    co_fiber_destroy(&fiber);
+}
+
+typedef struct {
+    co_msg_t next;
+    int value;
+} Msg;
+
+CO_DECLARE(static Send, co_chan_t* c, Msg msg)
+{
+CO_BEGIN:
+
+    CO_YIELD;   // let the fiber block first
+    CO_CHAN_WRITE(((Send*)CO_THIS)->c, &((Send*)CO_THIS)->msg);
+
+CO_END:;
+}
+
+CO_DECLARE(static Recv, co_chan_t* c, co_msg_t msgNext)
+{
+CO_BEGIN:
+
+    CO_CHAN_READ(((Recv*)CO_THIS)->c, &((Recv*)CO_THIS)->msgNext);
+
+CO_END:;
+}
+
+struct Pipe {
+    co_chan_t in;
+    co_chan_t out;
+    Msg reply;
+};
+
+// read a message from in, write its double to out
+static void run_chan(co_fiber_t* fiber, void* arg)
+{
+    Pipe* p = (Pipe*)arg;
+    co_msg_t msg_next;
+    co_fiber_chan_read(fiber, &p->in, &msg_next);
+    p->reply.value = ((Msg*)msg_next.next)->value * 2;
+    co_fiber_chan_write(fiber, &p->out, &p->reply.next);
+}
+
+CO_DECLARE(static Main, co_fiber_t* fiber, Send send, Recv recv)
+{
+CO_BEGIN:
+
+    CO_START(((Main*)CO_THIS)->fiber);
+    CO_START(&((Main*)CO_THIS)->send);
+    CO_AWAIT(&((Main*)CO_THIS)->recv);
+
+CO_END:;
+}
+
+TEST(Fiber, Chan)
+{
+    Pipe pipe = {CO_CHAN_MAKE(0), CO_CHAN_MAKE(0), {}};
+    co_fiber_t fiber;
+    ASSERT_EQ(co_fiber_init(&fiber, run_chan, &pipe, 0), 0);
+    Msg msg = {{}, 21};
+    auto main = CO_MAKE(Main, &fiber, CO_MAKE(Send, &pipe.in, msg), CO_MAKE(Recv, &pipe.out));
+    co_run(&main);
+
+    ASSERT_TRUE(main.recv.msgNext.next);
+    EXPECT_EQ(((Msg*)main.recv.msgNext.next)->value, 42);
+    EXPECT_EQ(CO_STATE(&fiber), -1);
+    co_fiber_destroy(&fiber);
+}
+
+static int overflow(int n)
+{
+    volatile char pad[256] = {};
+    pad[0] = (char)n;
+    return n < 0 ? 0 : overflow(n + 1) + pad[0];
+}
+
+static void run_overflow(co_fiber_t*, void*)
+{
+    overflow(0);
+}
+
+TEST(FiberDeathTest, Guard)
+{
+    co_fiber_t fiber;
+    ASSERT_EQ(co_fiber_init(&fiber, run_overflow, nullptr, 16 * 1024), 0);
+    EXPECT_DEATH(co_run(&fiber), "");
+    co_fiber_destroy(&fiber);
+}
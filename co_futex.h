@@ -0,0 +1,80 @@
+/* Wait on/wake a 32-bit word, Linux futex(2)
+
+* API
+cogo_futex_wait(int*, int, int)     : sleep if *int == int, shared between processes if the last int != 0
+cogo_futex_wake(int*, int, int)     : wake up at most int sleepers, shared between processes if the last int != 0
+cogo_futex_wait_any(int*[], int[], int, int)    : sleep if *int*[i] == int[i] for all i < int, shared if the last int != 0
+
+* Note
+- Waits may return spuriously, the caller should check the condition again.
+- Fall back to sched_yield() on other platforms, i.e. a busy wait.
+- cogo_futex_wait_any() uses futex_waitv(2) (Linux 5.16), or sleeps on the first word for at most 1 ms without it.
+
+*/
+#ifndef MOXITREL_COGO_CO_FUTEX_H_
+#define MOXITREL_COGO_CO_FUTEX_H_
+
+#if defined(__linux__)
+#   include <linux/futex.h>
+#   include <errno.h>
+#   include <stdint.h>
+#   include <sys/syscall.h>
+#   include <time.h>
+#   include <unistd.h>
+#else
+#   include <sched.h>
+#endif
+
+static inline void cogo_futex_wait(int* addr, int val, int shared)
+{
+#if defined(__linux__)
+    syscall(SYS_futex, addr, shared ? FUTEX_WAIT : FUTEX_WAIT_PRIVATE, val, NULL, NULL, 0);
+#else
+    (void)addr, (void)val, (void)shared;
+    sched_yield();
+#endif
+}
+
+static inline void cogo_futex_wake(int* addr, int n, int shared)
+{
+#if defined(__linux__)
+    syscall(SYS_futex, addr, shared ? FUTEX_WAKE : FUTEX_WAKE_PRIVATE, n, NULL, NULL, 0);
+#else
+    (void)addr, (void)n, (void)shared;
+#endif
+}
+
+// max words of cogo_futex_wait_any()
+#define COGO_FUTEX_WAITV_MAX    128
+
+static inline void cogo_futex_wait_any(int* const addrs[], const int vals[], int n, int shared)
+{
+#if defined(__linux__)
+#   if defined(__NR_futex_waitv) && defined(FUTEX_32)
+    struct futex_waitv waiters[COGO_FUTEX_WAITV_MAX];
+    if (n > COGO_FUTEX_WAITV_MAX) {
+        n = COGO_FUTEX_WAITV_MAX;
+    }
+    for (int i = 0; i < n; i++) {
+        waiters[i].val = (uint32_t)vals[i];
+        waiters[i].uaddr = (uintptr_t)addrs[i];
+        waiters[i].flags = FUTEX_32 | (shared ? 0 : FUTEX_PRIVATE_FLAG);
+        waiters[i].__reserved = 0;
+    }
+    if (syscall(__NR_futex_waitv, waiters, n, 0, NULL, 0) >= 0 || errno != ENOSYS) {
+        return;
+    }
+#   endif
+    if (n == 1) {
+        cogo_futex_wait(addrs[0], vals[0], shared);
+    } else if (n > 1) {
+        struct timespec ts = {0, 1000000};
+        syscall(SYS_futex, addrs[0], shared ? FUTEX_WAIT : FUTEX_WAIT_PRIVATE, vals[0], &ts, NULL, 0);
+    }
+#else
+    (void)addrs, (void)vals, (void)n, (void)shared;
+    sched_yield();
+#endif
+}
+
+#endif // MOXITREL_COGO_CO_FUTEX_H_
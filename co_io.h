@@ -0,0 +1,377 @@
+/* Non-blocking I/O for coroutines, Linux epoll
+
+* API
+co_io_t                                     : scheduler with an I/O poller and a pipe pool, inherit co_sch_t
+co_io_init   (co_io_t*)                     : return 0, or -1 with errno set
+co_io_destroy(co_io_t*)                     : ...
+co_io_run    (co_io_t*, co_t*)              : run the coroutine until all finished, wait for I/O when idle
+
+CO_IO_WAIT (int, uint32_t)                  : park the coroutine until fd ready for EPOLLIN or EPOLLOUT
+CO_SPLICE  (int fd_in, int fd_out, size_t)  : move bytes from fd_in to fd_out in kernel through a pooled pipe
+CO_SENDFILE(int fd_out, int fd_in, off_t, size_t)   : send a file from offset to fd_out in kernel
+
+co_splice_t                                 : result of CO_SPLICE  , read by CO_AWAITED(co_splice_t)
+co_sendfile_t                               : result of CO_SENDFILE, read by CO_AWAITED(co_sendfile_t)
+    .n  : bytes moved, less than requested if EOF reached or failed
+    .err: errno if failed, or 0
+
+* Example
+CO_DECLARE(Proxy, int from, int to)
+{
+CO_BEGIN:
+
+    do {
+        CO_SPLICE(((Proxy*)CO_THIS)->from, ((Proxy*)CO_THIS)->to, 1 << 20);
+    } while (CO_AWAITED(co_splice_t)->n > 0 && CO_AWAITED(co_splice_t)->err == 0);
+
+CO_END:;
+}
+
+* Note
+- fds should be non-blocking (O_NONBLOCK), or the scheduler thread is blocked.
+- The coroutines using them must be run by co_io_run().
+- CO_IO_WAIT() allows one reader and one writer per fd at the same time.
+
+*/
+#ifndef MOXITREL_COGO_CO_IO_H_
+#define MOXITREL_COGO_CO_IO_H_
+
+#ifndef _GNU_SOURCE
+#   define _GNU_SOURCE  // splice()
+#endif
+
+#include "co_st.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/epoll.h>
+#include <sys/sendfile.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+// max pipes cached by co_io_t
+#ifndef COGO_IO_PIPES
+#   define COGO_IO_PIPES        16
+#endif
+
+// bytes moved by a splice() call, pipe capacity
+#ifndef COGO_IO_PIPE_SIZE
+#   define COGO_IO_PIPE_SIZE    (1 << 16)
+#endif
+
+// poll I/O once every COGO_IO_POLL_STEPS steps if busy
+#ifndef COGO_IO_POLL_STEPS
+#   define COGO_IO_POLL_STEPS   64
+#endif
+
+// coroutines waiting a fd
+typedef struct {
+    co_t* reader;
+    co_t* writer;
+    // added to epoll
+    int added;
+} cogo_io_fd_t;
+
+typedef struct {
+    // inherit co_sch_t
+    co_sch_t sch;
+    int epfd;
+    // indexed by fd
+    cogo_io_fd_t* fds;
+    size_t nfds;
+    // number of waiting coroutines
+    size_t waiting;
+    // pipe pool
+    int pipes[COGO_IO_PIPES][2];
+    size_t npipes;
+} co_io_t;
+
+static inline int co_io_init(co_io_t* io)
+{
+    COGO_ASSERT(io);
+    *io = (co_io_t){
+        .epfd = epoll_create1(EPOLL_CLOEXEC),
+    };
+    return io->epfd < 0 ? -1 : 0;
+}
+
+static inline void co_io_destroy(co_io_t* io)
+{
+    COGO_ASSERT(io);
+    while (io->npipes > 0) {
+        io->npipes--;
+        close(io->pipes[io->npipes][0]);
+        close(io->pipes[io->npipes][1]);
+    }
+    free(io->fds);
+    io->fds = NULL;
+    io->nfds = 0;
+    if (io->epfd >= 0) {
+        close(io->epfd);
+        io->epfd = -1;
+    }
+    co_sch_destroy(&io->sch);
+}
+
+// (re)arm fd with the events of its waiters
+static inline int cogo_io_arm(co_io_t* io, int fd)
+{
+    cogo_io_fd_t* slot = &io->fds[fd];
+    struct epoll_event ev = {
+        .events = (slot->reader ? (uint32_t)EPOLLIN : 0) | (slot->writer ? (uint32_t)EPOLLOUT : 0) | EPOLLONESHOT,
+        .data = {.fd = fd},
+    };
+    // the fd may be closed and reused since added
+    if (slot->added && epoll_ctl(io->epfd, EPOLL_CTL_MOD, fd, &ev) == 0) {
+        return 0;
+    }
+    if (epoll_ctl(io->epfd, EPOLL_CTL_ADD, fd, &ev) == 0
+    || (errno == EEXIST && epoll_ctl(io->epfd, EPOLL_CTL_MOD, fd, &ev) == 0)) {
+        slot->added = 1;
+        return 0;
+    }
+    return -1;
+}
+
+// CO_IO_WAIT(int fd, uint32_t events): park until fd ready, not parked if failed with errno set
+#define CO_IO_WAIT(FD, EVENTS)                                                  \
+do {                                                                            \
+    if (cogo_io_wait((co_t*)(CO_THIS), (FD), (EVENTS)) == 0) {                  \
+        CO_YIELD;                                                               \
+    }                                                                           \
+} while (0)
+// return 0 if parked, or -1 with errno set
+static inline int cogo_io_wait(co_t* co, int fd, uint32_t events)
+{
+    COGO_ASSERT(co);
+    COGO_ASSERT(fd >= 0);
+    COGO_ASSERT(events == EPOLLIN || events == EPOLLOUT);
+
+    co_io_t* io = (co_io_t*)((cogo_co_t*)co)->sch;
+    if ((size_t)fd >= io->nfds) {
+        size_t nfds = io->nfds ? io->nfds : 64;
+        while (nfds <= (size_t)fd) {
+            nfds *= 2;
+        }
+        cogo_io_fd_t* fds = (cogo_io_fd_t*)realloc(io->fds, nfds * sizeof(*fds));
+        if (!fds) {
+            return -1;
+        }
+        for (size_t i = io->nfds; i < nfds; i++) {
+            fds[i] = (cogo_io_fd_t){.reader = NULL};
+        }
+        io->fds = fds;
+        io->nfds = nfds;
+    }
+
+    cogo_io_fd_t* slot = &io->fds[fd];
+    co_t** waiter = events == EPOLLIN ? &slot->reader : &slot->writer;
+    COGO_ASSERT(*waiter == NULL);
+    *waiter = co;
+    if (cogo_io_arm(io, fd) != 0) {
+        *waiter = NULL;
+        return -1;
+    }
+    io->waiting++;
+    // sleep in background
+    ((cogo_co_t*)co)->sch->stack_top = NULL;
+    return 0;
+}
+
+// move ready coroutines to the run queue, timeout in milliseconds (-1: infinite)
+static inline int co_io_poll(co_io_t* io, int timeout)
+{
+    COGO_ASSERT(io);
+    struct epoll_event events[64];
+    int n = epoll_wait(io->epfd, events, sizeof(events) / sizeof(events[0]), timeout);
+    for (int i = 0; i < n; i++) {
+        int fd = events[i].data.fd;
+        cogo_io_fd_t* slot = &io->fds[fd];
+        if (slot->reader && (events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP))) {
+            co_sch_fifo_push((cogo_sch_t*)&io->sch, (cogo_co_t*)slot->reader);
+            slot->reader = NULL;
+            io->waiting--;
+        }
+        if (slot->writer && (events[i].events & (EPOLLOUT | EPOLLERR | EPOLLHUP))) {
+            co_sch_fifo_push((cogo_sch_t*)&io->sch, (cogo_co_t*)slot->writer);
+            slot->writer = NULL;
+            io->waiting--;
+        }
+        if (slot->reader || slot->writer) {
+            // oneshot, arm again for the rest
+            cogo_io_arm(io, fd);
+        }
+    }
+    return n;
+}
+
+static inline void co_io_run(co_io_t* io, void* co)
+{
+    COGO_ASSERT(io);
+    io->sch.cogo_sch.stack_top = (cogo_co_t*)co;
+    for (unsigned steps = 0; ; steps++) {
+        if (io->waiting > 0 && steps % COGO_IO_POLL_STEPS == 0) {
+            co_io_poll(io, 0);
+        }
+        if (!io->sch.cogo_sch.stack_top) {
+            io->sch.cogo_sch.stack_top = co_sch_fifo_pop((cogo_sch_t*)&io->sch);
+        }
+        if (io->sch.cogo_sch.stack_top) {
+            co_sch_step(&io->sch);
+            continue;
+        }
+        if (io->waiting == 0) {
+            break;
+        }
+        co_io_poll(io, -1);
+    }
+}
+
+// take a pipe from pool, return 0 or errno
+static inline int cogo_io_pipe_get(co_io_t* io, int pipefd[2])
+{
+    if (io->npipes > 0) {
+        io->npipes--;
+        pipefd[0] = io->pipes[io->npipes][0];
+        pipefd[1] = io->pipes[io->npipes][1];
+        return 0;
+    }
+    if (pipe2(pipefd, O_NONBLOCK | O_CLOEXEC) != 0) {
+        return errno;
+    }
+    fcntl(pipefd[1], F_SETPIPE_SZ, COGO_IO_PIPE_SIZE);
+    return 0;
+}
+
+// return a pipe to pool, close it if not empty
+static inline void cogo_io_pipe_put(co_io_t* io, int pipefd[2], size_t buffered)
+{
+    if (buffered == 0 && io->npipes < COGO_IO_PIPES) {
+        io->pipes[io->npipes][0] = pipefd[0];
+        io->pipes[io->npipes][1] = pipefd[1];
+        io->npipes++;
+    } else {
+        close(pipefd[0]);
+        close(pipefd[1]);
+    }
+}
+
+typedef struct {
+    // inherit co_t
+    co_t co;
+    int fd_in;
+    int fd_out;
+    size_t len;
+    // result
+    size_t n;
+    int err;
+    // bytes in pipe
+    size_t buffered;
+    int pipe[2];
+} co_splice_t;
+
+// CO_SPLICE(int fd_in, int fd_out, size_t len)
+#define CO_SPLICE(FD_IN, FD_OUT, LEN)                                                   \
+    CO_AWAIT_NEW(co_splice_t, .fd_in = (FD_IN), .fd_out = (FD_OUT), .len = (LEN))
+
+static inline CO_DEFINE(co_splice_t)
+{
+    co_splice_t* thiz = (co_splice_t*)CO_THIS;
+    size_t len;
+    ssize_t r;
+CO_BEGIN:
+
+    thiz->err = cogo_io_pipe_get((co_io_t*)thiz->co.cogo_co.sch, thiz->pipe);
+    if (thiz->err != 0) {
+        CO_RETURN;
+    }
+    while (thiz->n < thiz->len) {
+        // fill the pipe
+        if (thiz->buffered == 0) {
+            len = thiz->len - thiz->n;
+            r = splice(thiz->fd_in, NULL, thiz->pipe[1], NULL, len < COGO_IO_PIPE_SIZE ? len : COGO_IO_PIPE_SIZE,
+                       SPLICE_F_MOVE | SPLICE_F_NONBLOCK | SPLICE_F_MORE);
+            if (r == 0) {
+                break;  // EOF
+            }
+            if (r < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                if (errno != EAGAIN || cogo_io_wait((co_t*)thiz, thiz->fd_in, EPOLLIN) != 0) {
+                    thiz->err = errno;
+                    break;
+                }
+                CO_YIELD;
+                continue;
+            }
+            thiz->buffered = (size_t)r;
+        }
+        // drain the pipe, don't cork the last chunk, e.g. on TCP
+        r = splice(thiz->pipe[0], NULL, thiz->fd_out, NULL, thiz->buffered,
+                   SPLICE_F_MOVE | SPLICE_F_NONBLOCK | (thiz->len - thiz->n > thiz->buffered ? SPLICE_F_MORE : 0));
+        if (r < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno != EAGAIN || cogo_io_wait((co_t*)thiz, thiz->fd_out, EPOLLOUT) != 0) {
+                thiz->err = errno;
+                break;
+            }
+            CO_YIELD;
+            continue;
+        }
+        thiz->buffered -= (size_t)r;
+        thiz->n += (size_t)r;
+    }
+    cogo_io_pipe_put((co_io_t*)thiz->co.cogo_co.sch, thiz->pipe, thiz->buffered);
+
+CO_END:;
+}
+
+typedef struct {
+    // inherit co_t
+    co_t co;
+    int fd_out;
+    int fd_in;
+    off_t offset;
+    size_t len;
+    // result
+    size_t n;
+    int err;
+} co_sendfile_t;
+
+// CO_SENDFILE(int fd_out, int fd_in, off_t offset, size_t len)
+#define CO_SENDFILE(FD_OUT, FD_IN, OFFSET, LEN)                                         \
+    CO_AWAIT_NEW(co_sendfile_t, .fd_out = (FD_OUT), .fd_in = (FD_IN), .offset = (OFFSET), .len = (LEN))
+
+static inline CO_DEFINE(co_sendfile_t)
+{
+    co_sendfile_t* thiz = (co_sendfile_t*)CO_THIS;
+    ssize_t r;
+CO_BEGIN:
+
+    while (thiz->n < thiz->len) {
+        r = sendfile(thiz->fd_out, thiz->fd_in, &thiz->offset, thiz->len - thiz->n);
+        if (r == 0) {
+            break;  // EOF
+        }
+        if (r < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno != EAGAIN || cogo_io_wait((co_t*)thiz, thiz->fd_out, EPOLLOUT) != 0) {
+                thiz->err = errno;
+                break;
+            }
+            CO_YIELD;
+            continue;
+        }
+        thiz->n += (size_t)r;
+    }
+
+CO_END:;
+}
+
+#endif // MOXITREL_COGO_CO_IO_H_
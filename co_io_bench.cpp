@@ -0,0 +1,168 @@
+// Proxy throughput over loopback TCP: CO_SPLICE vs read()/write() through a user buffer.
+// usage: co_io_bench [MiB]
+#include "co_io.h"
+#include <arpa/inet.h>
+#include <chrono>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+
+static size_t total;
+static char buffer[1 << 16];
+
+CO_DECLARE(static Producer, int fd, size_t n)
+{
+    auto* thiz = (Producer*)CO_THIS;
+    ssize_t r;
+CO_BEGIN:
+
+    while (thiz->n < total) {
+        r = write(thiz->fd, buffer, total - thiz->n < sizeof(buffer) ? total - thiz->n : sizeof(buffer));
+        if (r < 0) {
+            CO_IO_WAIT(thiz->fd, EPOLLOUT);
+            continue;
+        }
+        thiz->n += (size_t)r;
+    }
+    shutdown(thiz->fd, SHUT_WR);
+
+CO_END:;
+}
+
+CO_DECLARE(static Consumer, int fd, size_t n)
+{
+    auto* thiz = (Consumer*)CO_THIS;
+    char buf[1 << 16];
+    ssize_t r;
+CO_BEGIN:
+
+    for (;;) {
+        r = read(thiz->fd, buf, sizeof(buf));
+        if (r == 0) {
+            break;
+        }
+        if (r < 0) {
+            CO_IO_WAIT(thiz->fd, EPOLLIN);
+            continue;
+        }
+        thiz->n += (size_t)r;
+    }
+
+CO_END:;
+}
+
+CO_DECLARE(static SpliceProxy, int from, int to)
+{
+    auto* thiz = (SpliceProxy*)CO_THIS;
+CO_BEGIN:
+
+    do {
+        CO_SPLICE(thiz->from, thiz->to, (size_t)-1);
+    } while (CO_AWAITED(co_splice_t)->n > 0 && CO_AWAITED(co_splice_t)->err == 0);
+    shutdown(thiz->to, SHUT_WR);
+
+CO_END:;
+}
+
+CO_DECLARE(static CopyProxy, int from, int to, ssize_t len, ssize_t off)
+{
+    auto* thiz = (CopyProxy*)CO_THIS;
+    static char buf[1 << 16];
+    ssize_t r;
+CO_BEGIN:
+
+    for (;;) {
+        thiz->len = read(thiz->from, buf, sizeof(buf));
+        if (thiz->len == 0) {
+            break;
+        }
+        if (thiz->len < 0) {
+            CO_IO_WAIT(thiz->from, EPOLLIN);
+            continue;
+        }
+        for (thiz->off = 0; thiz->off < thiz->len;) {
+            r = write(thiz->to, buf + thiz->off, (size_t)(thiz->len - thiz->off));
+            if (r < 0) {
+                CO_IO_WAIT(thiz->to, EPOLLOUT);
+                continue;
+            }
+            thiz->off += r;
+        }
+    }
+    shutdown(thiz->to, SHUT_WR);
+
+CO_END:;
+}
+
+CO_DECLARE(static Entry, Producer producer, co_t* proxy, Consumer consumer)
+{
+    auto* thiz = (Entry*)CO_THIS;
+CO_BEGIN:
+
+    CO_START(&thiz->producer);
+    CO_START(thiz->proxy);
+    CO_START(&thiz->consumer);
+
+CO_END:;
+}
+
+// connected non-blocking loopback TCP sockets
+static void tcp_pair(int fds[2])
+{
+    struct sockaddr_in addr = {};
+    socklen_t len = sizeof(addr);
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    int server = socket(AF_INET, SOCK_STREAM, 0);
+    if (server < 0
+    ||  bind(server, (struct sockaddr*)&addr, sizeof(addr)) != 0
+    ||  listen(server, 1) != 0
+    ||  getsockname(server, (struct sockaddr*)&addr, &len) != 0
+    ||  (fds[0] = socket(AF_INET, SOCK_STREAM, 0)) < 0
+    ||  connect(fds[0], (struct sockaddr*)&addr, sizeof(addr)) != 0
+    ||  (fds[1] = accept(server, NULL, NULL)) < 0) {
+        perror("tcp_pair");
+        exit(1);
+    }
+    close(server);
+    for (int i = 0; i < 2; i++) {
+        fcntl(fds[i], F_SETFL, fcntl(fds[i], F_GETFL) | O_NONBLOCK);
+    }
+}
+
+static void bench(const char* name, bool splice)
+{
+    int in[2];
+    int out[2];
+    tcp_pair(in);
+    tcp_pair(out);
+
+    co_io_t io;
+    if (co_io_init(&io) != 0) {
+        perror("co_io_init");
+        exit(1);
+    }
+    auto splice_proxy = CO_MAKE(SpliceProxy, in[1], out[0]);
+    auto copy_proxy = CO_MAKE(CopyProxy, in[1], out[0]);
+    auto entry = CO_MAKE(Entry, CO_MAKE(Producer, in[0]), splice ? (co_t*)&splice_proxy : (co_t*)&copy_proxy, CO_MAKE(Consumer, out[1]));
+    auto t0 = std::chrono::steady_clock::now();
+    co_io_run(&io, &entry);
+    double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    printf("%-8s %8.1f MiB/s%s\n", name, (double)entry.consumer.n / s / (1 << 20), entry.consumer.n == total ? "" : " (short)");
+
+    co_io_destroy(&io);
+    for (int i = 0; i < 2; i++) {
+        close(in[i]);
+        close(out[i]);
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    total = (size_t)(argc > 1 ? atol(argv[1]) : 1024) << 20;
+    bench("copy", false);
+    bench("splice", true);
+    return 0;
+}
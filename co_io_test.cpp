@@ -0,0 +1,182 @@
+#include <assert.h>
+#include "co_io.h"
+#include "gtest/gtest.h"
+#include <stdio.h>
+#include <sys/socket.h>
+#include <vector>
+
+static const size_t kSize = 1 << 20;
+
+static unsigned char pattern(size_t i)
+{
+    return (unsigned char)(i * 7 + i / 251);
+}
+
+// write kSize bytes of pattern
+CO_DECLARE(static Producer, int fd, size_t n)
+{
+    auto* thiz = (Producer*)CO_THIS;
+    unsigned char buf[4096];
+    ssize_t r;
+CO_BEGIN:
+
+    while (thiz->n < kSize) {
+        for (size_t i = 0; i < sizeof(buf); i++) {
+            buf[i] = pattern(thiz->n + i);
+        }
+        r = write(thiz->fd, buf, kSize - thiz->n < sizeof(buf) ? kSize - thiz->n : sizeof(buf));
+        if (r < 0) {
+            ASSERT_EQ(errno, EAGAIN);
+            CO_IO_WAIT(thiz->fd, EPOLLOUT);
+            continue;
+        }
+        thiz->n += (size_t)r;
+    }
+    close(thiz->fd);
+
+CO_END:;
+}
+
+// read until EOF, verify the pattern
+CO_DECLARE(static Consumer, int fd, size_t n, bool ok)
+{
+    auto* thiz = (Consumer*)CO_THIS;
+    unsigned char buf[4096];
+    ssize_t r;
+CO_BEGIN:
+
+    thiz->ok = true;
+    for (;;) {
+        r = read(thiz->fd, buf, sizeof(buf));
+        if (r == 0) {
+            break;
+        }
+        if (r < 0) {
+            ASSERT_EQ(errno, EAGAIN);
+            CO_IO_WAIT(thiz->fd, EPOLLIN);
+            continue;
+        }
+        for (ssize_t i = 0; i < r; i++) {
+            thiz->ok = thiz->ok && buf[i] == pattern(thiz->n + (size_t)i);
+        }
+        thiz->n += (size_t)r;
+    }
+
+CO_END:;
+}
+
+CO_DECLARE(static Proxy, int from, int to, size_t n, int err)
+{
+    auto* thiz = (Proxy*)CO_THIS;
+CO_BEGIN:
+
+    do {
+        CO_SPLICE(thiz->from, thiz->to, kSize);
+        thiz->n += CO_AWAITED(co_splice_t)->n;
+        thiz->err = CO_AWAITED(co_splice_t)->err;
+    } while (CO_AWAITED(co_splice_t)->n > 0 && thiz->err == 0);
+    shutdown(thiz->to, SHUT_WR);
+
+CO_END:;
+}
+
+CO_DECLARE(static Send, int to, int file, size_t n, int err)
+{
+    auto* thiz = (Send*)CO_THIS;
+CO_BEGIN:
+
+    CO_SENDFILE(thiz->to, thiz->file, 0, kSize);
+    thiz->n = CO_AWAITED(co_sendfile_t)->n;
+    thiz->err = CO_AWAITED(co_sendfile_t)->err;
+    shutdown(thiz->to, SHUT_WR);
+
+CO_END:;
+}
+
+CO_DECLARE(static Entry, Producer producer, Proxy proxy, Send send, Consumer consumer)
+{
+    auto* thiz = (Entry*)CO_THIS;
+CO_BEGIN:
+
+    if (thiz->producer.fd > 0) {
+        CO_START(&thiz->producer);
+    }
+    if (thiz->proxy.to > 0) {
+        CO_START(&thiz->proxy);
+    }
+    if (thiz->send.to > 0) {
+        CO_START(&thiz->send);
+    }
+    CO_START(&thiz->consumer);
+
+CO_END:;
+}
+
+static void small_buffer(int fd)
+{
+    int size = 4096;
+    setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+}
+
+TEST(Io, Splice)
+{
+    int p[2];
+    int s[2];
+    ASSERT_EQ(pipe2(p, O_NONBLOCK), 0);
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, s), 0);
+    small_buffer(s[0]);
+    small_buffer(s[1]);
+
+    co_io_t io;
+    ASSERT_EQ(co_io_init(&io), 0);
+    auto entry = CO_MAKE(Entry,
+            CO_MAKE(Producer, p[1]),
+            CO_MAKE(Proxy, p[0], s[0]),
+            CO_MAKE(Send, -1),
+            CO_MAKE(Consumer, s[1]));
+    co_io_run(&io, &entry);
+    EXPECT_EQ(entry.proxy.err, 0);
+    EXPECT_EQ(entry.proxy.n, kSize);
+    EXPECT_EQ(entry.consumer.n, kSize);
+    EXPECT_TRUE(entry.consumer.ok);
+    EXPECT_EQ(io.npipes, 1u);   // reused
+
+    co_io_destroy(&io);
+    close(p[0]);
+    close(s[0]);
+    close(s[1]);
+}
+
+TEST(Io, Sendfile)
+{
+    FILE* file = tmpfile();
+    std::vector<unsigned char> data(kSize);
+    for (size_t i = 0; i < kSize; i++) {
+        data[i] = pattern(i);
+    }
+    ASSERT_EQ(fwrite(data.data(), 1, data.size(), file), data.size());
+    fflush(file);
+    int s[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, s), 0);
+    small_buffer(s[0]);
+    small_buffer(s[1]);
+
+    co_io_t io;
+    ASSERT_EQ(co_io_init(&io), 0);
+    auto entry = CO_MAKE(Entry,
+            CO_MAKE(Producer, -1),
+            CO_MAKE(Proxy, -1, -1),
+            CO_MAKE(Send, s[0], fileno(file)),
+            CO_MAKE(Consumer, s[1]));
+    co_io_run(&io, &entry);
+    EXPECT_EQ(entry.send.err, 0);
+    EXPECT_EQ(entry.send.n, kSize);
+    EXPECT_EQ(entry.consumer.n, kSize);
+    EXPECT_TRUE(entry.consumer.ok);
+
+    co_io_destroy(&io);
+    fclose(file);
+    close(s[0]);
+    close(s[1]);
+}
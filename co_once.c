@@ -0,0 +1,3 @@
+#include "co_once.h"
+
+extern inline int cogo_once_await(co_t* co, co_once_t* once);
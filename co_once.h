@@ -0,0 +1,101 @@
+/*
+
+* API
+co_once_t                           : shared awaitable type, a computation run once for all awaiters
+CO_ONCE_MAKE (co_t*)                : return a co_once_t over a coroutine not started, made by CO_MAKE()
+CO_ONCE_AWAIT(co_once_t*)           : await the coroutine, started by the first awaiter, the others park until it finished
+co_once_done (co_once_t*)           : if the coroutine finished
+
+* Example
+CO_DECLARE(Load, int value)
+{
+CO_BEGIN:
+    ...                                                 // expensive, may yield
+    ((Load*)CO_THIS)->value = 42;
+CO_END:;
+}
+
+Load load = CO_MAKE(Load);
+co_once_t once = CO_ONCE_MAKE(&load);
+
+CO_DECLARE(Request, co_once_t* once)
+{
+CO_BEGIN:
+
+    CO_ONCE_AWAIT(((Request*)CO_THIS)->once);           // any number of requests
+    ((Load*)((Request*)CO_THIS)->once->co)->value;      // 42
+
+CO_END:;
+}
+
+* Note
+- The first awaiter runs the coroutine by CO_AWAIT(), i.e. it's the caller. The coroutine is never run again,
+  later awaiters return at once.
+- The parked awaiters are resumed in one pass when the first awaiter is resumed, after it.
+- Awaiters must run in the same scheduler, the result is read from the coroutine.
+
+*/
+#ifndef MOXITREL_COGO_CO_ONCE_H_
+#define MOXITREL_COGO_CO_ONCE_H_
+
+#include "co_st.h"
+
+typedef struct {
+    // the computation
+    co_t* const co;
+    // the first awaiter, the caller of co, NULL if not started
+    co_t* owner;
+    // co finished
+    bool done;
+    // awaiters parked until done, linked by co_t.next
+    co_queue_t wq;
+} co_once_t;
+
+#define CO_ONCE_MAKE(CO)    ((co_once_t){.co = (co_t*)(CO),})
+
+static inline bool co_once_done(const co_once_t* once)
+{
+    COGO_ASSERT(once);
+    return once->done;
+}
+
+// CO_ONCE_AWAIT(co_once_t*);
+#define CO_ONCE_AWAIT(ONCE)                                                                         \
+do {                                                                                                \
+    while (cogo_once_await((co_t*)(CO_THIS), (ONCE)) != 0) {                                        \
+        CO_YIELD;                                                                                   \
+    }                                                                                               \
+} while (0)
+// return !0 if awaiting or parked, should be retried when resumed
+inline int cogo_once_await(co_t* co, co_once_t* once)
+{
+//  COGO_ASSERT(co);
+    COGO_ASSERT(once);
+    COGO_ASSERT(once->co);
+
+    if (once->done) {
+        return 0;
+    }
+    if (!once->owner) {
+        // the first awaiter, run the computation
+        once->owner = co;
+        cogo_co_await((cogo_co_t*)co, (cogo_co_t*)once->co);
+        return 1;
+    }
+    if (once->owner == co) {
+        // resumed by the finished computation, wake up all others in one pass
+        once->done = true;
+        cogo_sch_t* sch = ((cogo_co_t*)co)->sch;
+        co_t* waiter;
+        while ((waiter = (co_t*)co_queue_pop(&once->wq, offsetof(co_t, next))) != NULL) {
+            cogo_sch_ready(sch, (cogo_co_t*)waiter);
+        }
+        return 0;
+    }
+    // sleep in background
+    co_queue_push(&once->wq, offsetof(co_t, next), co);
+    ((cogo_co_t*)co)->sch->stack_top = NULL;
+    return 1;
+}
+
+#endif // MOXITREL_COGO_CO_ONCE_H_
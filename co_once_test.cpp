@@ -0,0 +1,85 @@
+#include "co_once.h"
+#include "gtest/gtest.h"
+#include <string>
+
+static int loads;
+static std::string trace;
+
+CO_DECLARE(static Load, int value)
+{
+    auto* thiz = (Load*)CO_THIS;
+CO_BEGIN:
+
+    loads++;
+    CO_YIELD;
+    CO_YIELD;
+    thiz->value = 42;
+
+CO_END:;
+}
+
+CO_DECLARE(static Request, co_once_t* once, char id, int value)
+{
+    auto* thiz = (Request*)CO_THIS;
+CO_BEGIN:
+
+    CO_ONCE_AWAIT(thiz->once);
+    thiz->value = ((Load*)thiz->once->co)->value;
+    trace += thiz->id;
+
+CO_END:;
+}
+
+CO_DECLARE(static Entry, Request reqs[4], Request late, int i)
+{
+    auto* thiz = (Entry*)CO_THIS;
+CO_BEGIN:
+
+    for (thiz->i = 0; thiz->i < 4; thiz->i++) {
+        CO_START(&thiz->reqs[thiz->i]);
+    }
+    while (!co_once_done(thiz->reqs[0].once)) {
+        CO_YIELD;
+    }
+    // finished, not started again
+    CO_AWAIT(&thiz->late);
+
+CO_END:;
+}
+
+TEST(Once, SingleFlight)
+{
+    loads = 0;
+    trace.clear();
+    Load load = CO_MAKE(Load);
+    co_once_t once = CO_ONCE_MAKE(&load);
+    Entry entry = CO_MAKE(Entry,
+        {CO_MAKE(Request, &once, 'a'), CO_MAKE(Request, &once, 'b'), CO_MAKE(Request, &once, 'c'), CO_MAKE(Request, &once, 'd')},
+        CO_MAKE(Request, &once, 'e'));
+    co_run(&entry);
+
+    EXPECT_EQ(loads, 1);
+    EXPECT_TRUE(co_once_done(&once));
+    // the first awaiter resumed first, the late one never parked
+    ASSERT_EQ(trace.size(), 5u);
+    EXPECT_EQ(trace[0], 'a');
+    EXPECT_EQ(trace[4], 'e');
+    for (int i = 0; i < 4; i++) {
+        EXPECT_EQ(entry.reqs[i].value, 42);
+    }
+    EXPECT_EQ(entry.late.value, 42);
+}
+
+TEST(Once, Done)
+{
+    loads = 0;
+    Load load = CO_MAKE(Load);
+    co_once_t once = CO_ONCE_MAKE(&load);
+    EXPECT_FALSE(co_once_done(&once));
+
+    Request req = CO_MAKE(Request, &once, 'x');
+    co_run(&req);
+    EXPECT_TRUE(co_once_done(&once));
+    EXPECT_EQ(req.value, 42);
+    EXPECT_EQ(loads, 1);
+}
@@ -0,0 +1,197 @@
+/* Yield-site sampling profiler, enabled by defining COGO_PROFILE (for the whole program, see the CMake option), included by co.h.
+
+* API
+cogo_prof_t                             : profile data, attached to a scheduler by cogo_sch_t.prof
+cogo_prof_init(cogo_prof_t*, unsigned)  : reset, sample 1 of every unsigned steps
+cogo_prof_dump(cogo_prof_t*, FILE*)     : write the folded stacks for flamegraph.pl, in estimated nanoseconds
+
+* Example
+    static cogo_prof_t prof;            // big, don't put on stack
+    cogo_prof_init(&prof, 16);
+    sch.prof = &prof;
+    ...                                 // run the scheduler
+    cogo_prof_dump(&prof, stdout);      // Entry_func@main.c:42;Recv_func@main.c:17 123456
+
+* Note
+- A sample is the logical coroutine stack built by walking cogo_co_t.caller from the resumed coroutine.
+  Each frame is "function@file:line", the line is where the coroutine is resumed, i.e. the last CO_YIELD/CO_AWAIT,
+  or no line if it starts from CO_BEGIN.
+- Names are recorded by CO_BEGIN on sampled steps only, a function never sampled is dumped by its address.
+- Stacks deeper than COGO_PROF_DEPTH are truncated (root frames dropped), samples not fitting in COGO_PROF_STACKS
+  are counted in cogo_prof_t.lost.
+
+*/
+#ifndef MOXITREL_COGO_CO_PROF_H_
+#define MOXITREL_COGO_CO_PROF_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+// max frames of a sample
+#ifndef COGO_PROF_DEPTH
+#   define COGO_PROF_DEPTH      16
+#endif
+
+// max different stacks, power of 2
+#ifndef COGO_PROF_STACKS
+#   define COGO_PROF_STACKS     1024
+#endif
+
+// max different coroutine functions, power of 2
+#ifndef COGO_PROF_FUNCS
+#   define COGO_PROF_FUNCS      256
+#endif
+
+typedef struct {
+    void (*func)(void*);
+    // CO_STATE() when resumed
+    int line;
+} cogo_prof_site_t;
+
+typedef struct {
+    // leaf first
+    cogo_prof_site_t sites[COGO_PROF_DEPTH];
+    int depth;
+    uint64_t count;
+    // estimated, sampled time * period
+    uint64_t ns;
+} cogo_prof_stack_t;
+
+// name of coroutine function, recorded by CO_BEGIN
+typedef struct {
+    void (*func)(void*);
+    const char* name;
+    const char* file;
+} cogo_prof_func_t;
+
+struct cogo_prof {
+    unsigned period;
+    unsigned tick;
+    uint64_t lost;
+    // the coroutine called by a sampled step, its name recorded by CO_BEGIN
+    cogo_co_t* sampling;
+    cogo_prof_func_t funcs[COGO_PROF_FUNCS];
+    cogo_prof_stack_t stacks[COGO_PROF_STACKS];
+};
+
+static inline void cogo_prof_init(cogo_prof_t* prof, unsigned period)
+{
+    COGO_ASSERT(prof);
+    memset(prof, 0, sizeof(*prof));
+    prof->period = period ? period : 1;
+}
+
+inline size_t cogo_prof_hash(uintptr_t h)
+{
+    h ^= h >> 17;
+    h *= (uintptr_t)0x9E3779B97F4A7C15ull;
+    return (size_t)(h ^ (h >> 29));
+}
+
+// COGO_ON_BEGIN: record the name of the running coroutine function, on sampled steps only
+static inline void cogo_prof_begin(cogo_co_t* co, const char* name, const char* file)
+{
+    if (!co->sch || !co->sch->prof || co->sch->prof->sampling != co) {
+        return;
+    }
+    cogo_prof_func_t* funcs = co->sch->prof->funcs;
+    for (size_t i = cogo_prof_hash((uintptr_t)co->func), n = 0; n < COGO_PROF_FUNCS; i++, n++) {
+        cogo_prof_func_t* f = &funcs[i & (COGO_PROF_FUNCS - 1)];
+        if (f->func == co->func) {
+            return;
+        }
+        if (!f->func) {
+            f->func = co->func;
+            f->name = name;
+            f->file = file;
+            return;
+        }
+    }
+}
+
+inline uint64_t cogo_prof_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+// COGO_SCH_CALL: run the stack top, sample 1 of prof->period calls
+inline void cogo_prof_call(cogo_sch_t* sch)
+{
+    cogo_co_t* co = sch->stack_top;
+    cogo_prof_t* prof = sch->prof;
+    if (!prof || ++prof->tick < prof->period) {
+        co->func(co);
+        return;
+    }
+    prof->tick = 0;
+
+    // the logical stack
+    cogo_prof_stack_t sample;
+    sample.depth = 0;
+    uintptr_t h = 0;
+    for (cogo_co_t* p = co; p && sample.depth < COGO_PROF_DEPTH; p = p->caller) {
+        sample.sites[sample.depth].func = p->func;
+        sample.sites[sample.depth].line = CO_STATE(p);
+        sample.depth++;
+        h = cogo_prof_hash(h ^ (uintptr_t)p->func ^ ((uintptr_t)CO_STATE(p) << 48));
+    }
+
+    uint64_t t0 = cogo_prof_now();
+    prof->sampling = co;
+    co->func(co);
+    prof->sampling = NULL;
+    uint64_t ns = (cogo_prof_now() - t0) * prof->period;
+
+    for (size_t i = h, n = 0; n < COGO_PROF_STACKS; i++, n++) {
+        cogo_prof_stack_t* s = &prof->stacks[i & (COGO_PROF_STACKS - 1)];
+        if (s->depth == 0) {
+            memcpy(s->sites, sample.sites, sizeof(s->sites[0]) * (size_t)sample.depth);
+            s->depth = sample.depth;
+        } else if (s->depth != sample.depth || memcmp(s->sites, sample.sites, sizeof(s->sites[0]) * (size_t)sample.depth) != 0) {
+            continue;
+        }
+        s->count++;
+        s->ns += ns;
+        return;
+    }
+    prof->lost++;
+}
+
+static inline void cogo_prof_dump(const cogo_prof_t* prof, FILE* out)
+{
+    COGO_ASSERT(prof);
+    COGO_ASSERT(out);
+    for (size_t i = 0; i < COGO_PROF_STACKS; i++) {
+        const cogo_prof_stack_t* s = &prof->stacks[i];
+        if (s->depth == 0) {
+            continue;
+        }
+        // root first
+        for (int d = s->depth - 1; d >= 0; d--) {
+            const cogo_prof_site_t* site = &s->sites[d];
+            const cogo_prof_func_t* f = NULL;
+            for (size_t j = cogo_prof_hash((uintptr_t)site->func), n = 0; n < COGO_PROF_FUNCS; j++, n++) {
+                f = &prof->funcs[j & (COGO_PROF_FUNCS - 1)];
+                if (f->func == site->func || !f->func) {
+                    break;
+                }
+            }
+            if (f && f->func == site->func) {
+                fprintf(out, "%s@%s", f->name, f->file);
+            } else {
+                fprintf(out, "%p", (void*)(uintptr_t)site->func);
+            }
+            if (site->line > 0) {
+                fprintf(out, ":%d", site->line);
+            }
+            fputc(d > 0 ? ';' : ' ', out);
+        }
+        fprintf(out, "%llu\n", (unsigned long long)s->ns);
+    }
+}
+
+#endif // MOXITREL_COGO_CO_PROF_H_
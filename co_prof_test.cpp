@@ -0,0 +1,101 @@
+#include <assert.h>
+#include "co_st.h"
+#include "gtest/gtest.h"
+#include <string>
+
+static int leafLine;
+static int awaitLine;
+
+CO_DECLARE(static Leaf, int i)
+{
+    auto* thiz = (Leaf*)CO_THIS;
+CO_BEGIN:
+
+    for (thiz->i = 0; thiz->i < 100; thiz->i++) {
+        leafLine = __LINE__ + 1;
+        CO_YIELD;
+    }
+
+CO_END:;
+}
+
+CO_DECLARE(static Root, Leaf leaf)
+{
+    auto* thiz = (Root*)CO_THIS;
+CO_BEGIN:
+
+    awaitLine = __LINE__ + 1;
+    CO_AWAIT(&thiz->leaf);
+
+CO_END:;
+}
+
+static std::string dump(const cogo_prof_t* prof)
+{
+    FILE* out = tmpfile();
+    cogo_prof_dump(prof, out);
+    std::string folded(size_t(ftell(out)), '\0');
+    rewind(out);
+    EXPECT_EQ(fread(&folded[0], 1, folded.size(), out), folded.size());
+    fclose(out);
+    return folded;
+}
+
+TEST(Prof, FoldedStack)
+{
+    static cogo_prof_t prof;
+    cogo_prof_init(&prof, 1);
+
+    auto root = CO_MAKE(Root, CO_MAKE(Leaf));
+    co_sch_t sch = {};
+    sch.cogo_sch.stack_top = (cogo_co_t*)&root;
+    sch.cogo_sch.prof = &prof;
+    while (co_sch_step(&sch))
+    {}
+    co_sch_destroy(&sch);
+    EXPECT_EQ(CO_STATE(&root), -1);
+    EXPECT_EQ(prof.lost, 0u);
+
+    auto folded = dump(&prof);
+    // the leaf resumed at its yield, the root resumed at its await
+    auto hot = "Root_func@" __FILE__ ":" + std::to_string(awaitLine) + ";Leaf_func@" __FILE__ ":" + std::to_string(leafLine) + " ";
+    EXPECT_NE(folded.find(hot), std::string::npos) << folded;
+    // started from CO_BEGIN
+    EXPECT_NE(folded.find("Root_func@" __FILE__ " "), std::string::npos) << folded;
+
+    uint64_t count = 0;
+    for (auto& s : prof.stacks) {
+        count += s.count;
+    }
+    EXPECT_EQ(count, 1u + 101u + 1u);   // root begin, leaf begin & 100 yields, root after await
+}
+
+TEST(Prof, Period)
+{
+    static cogo_prof_t prof;
+    cogo_prof_init(&prof, 10);
+
+    auto root = CO_MAKE(Root, CO_MAKE(Leaf));
+    co_sch_t sch = {};
+    sch.cogo_sch.stack_top = (cogo_co_t*)&root;
+    sch.cogo_sch.prof = &prof;
+    while (co_sch_step(&sch))
+    {}
+    co_sch_destroy(&sch);
+
+    uint64_t count = 0;
+    for (auto& s : prof.stacks) {
+        count += s.count;
+    }
+    EXPECT_EQ(count, 10u);
+
+    // named on sampled steps only, the root runs on the 1st and the 103rd
+    size_t named = 0;
+    for (auto& f : prof.funcs) {
+        if (f.func) {
+            EXPECT_EQ(f.func, Leaf_func);
+            named++;
+        }
+    }
+    EXPECT_EQ(named, 1u);
+}
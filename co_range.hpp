@@ -0,0 +1,449 @@
+/* C++ input range over a generator coroutine, resumed in place by a direct call, and fused pipelines over it.
+
+* API
+cogo::generate<NAME>()                  : range of const NAME&, the coroutine after each yield
+cogo::generate<NAME>(T NAME::*)         : range of const T&, the field after each yield
+cogo::generate(NAME, [T NAME::*])       : ditto, start from a coroutine made by CO_MAKE(NAME, ...)
+
+range | cogo::map(f)                    : range of f(v), f called once per element
+range | cogo::filter(pred)              : range of v if pred(v)
+range | cogo::take(size_t)              : range of the first size_t elements
+range | cogo::batch<N>()                : range of cogo::span, up to N elements copied into an array
+cogo::zip(range, range)                 : range of std::pair, ends with the shorter one
+
+* Example
+CO_DECLARE(Nat, int value)
+{
+CO_BEGIN:
+
+    for (;; ((Nat*)CO_THIS)->value++) {
+        CO_YIELD;
+    }
+
+CO_END:;
+}
+
+for (int v : cogo::generate<Nat>(&Nat::value)) {    // 0, 1, 2, ...
+    if (v == 10) {
+        break;
+    }
+}
+
+auto odd_squares = cogo::generate<Nat>(&Nat::value)
+                 | cogo::map([](int v) { return v * v; })
+                 | cogo::filter([](int v) { return v % 2 != 0; })
+                 | cogo::take(1000)
+                 | cogo::batch<64>();
+for (cogo::span<int> b : odd_squares) {                 // 64 elements a time
+    write(fd, b.data, b.size * sizeof(int));            // for the code taking contiguous elements
+}
+
+* Note
+- The coroutine must be declared by CO_DECLARE() in C++ code, which defines the overload cogo_resume(NAME*).
+- It's resumed without a scheduler, i.e. it can only CO_YIELD, not CO_AWAIT/CO_START or use channels.
+- The range ends when the coroutine finished (CO_STATE() == -1), the value after the last yield is the last one.
+- The coroutine is stored in the range, an iterator is valid while the range lives.
+- GCC never inlines a function with computed goto (yield_label_value.h), define COGO_CASE to use yield_case.h
+  and let the coroutine be inlined into the loop.
+- A pipeline is one stage object holding the ones before by value, the coroutine included. An element is pulled
+  through all stages by inlined calls, only the coroutine is resumed, once per element.
+- A stage must not be copied or moved after begin() called.
+- batch() is for the code taking contiguous elements, it isn't faster than the loop over elements: each element
+  is copied once more, and the coroutine state is kept in memory across batches (see co_range_bench.cpp).
+
+*/
+#ifndef MOXITREL_COGO_CO_RANGE_HPP_
+#define MOXITREL_COGO_CO_RANGE_HPP_
+
+#include "yield.h"
+#include <cstddef>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+
+namespace cogo {
+
+// projection of the whole coroutine
+struct identity {
+    template <typename Co>
+    const Co& operator()(const Co& co) const
+    {
+        return co;
+    }
+};
+
+// projection of a field
+template <typename Co, typename T>
+struct field {
+    T Co::*p;
+
+    const T& operator()(const Co& co) const
+    {
+        return co.*p;
+    }
+};
+
+// iterator over a stage, which has
+//  bool next() : move to the next element, false if no more
+//  value()     : the current element
+template <typename Stage>
+class stage_iterator {
+public:
+    using iterator_category = std::input_iterator_tag;
+    using reference = decltype(std::declval<Stage&>().value());
+    using value_type = typename std::decay<reference>::type;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const value_type*;
+
+    // move to the first element
+    stage_iterator(Stage* s = nullptr)
+        : s_(s)
+        , done_(!s || !s->next())
+    {
+    }
+
+    reference operator*() const
+    {
+        return s_->value();
+    }
+
+    stage_iterator& operator++()
+    {
+        done_ = !s_->next();
+        return *this;
+    }
+
+    void operator++(int)
+    {
+        ++*this;
+    }
+
+    // equal if both at the end, or both not, i.e. an input iterator only compared with end()
+    bool operator==(const stage_iterator& other) const
+    {
+        return done_ == other.done_;
+    }
+
+    bool operator!=(const stage_iterator& other) const
+    {
+        return !(*this == other);
+    }
+
+private:
+    Stage* s_;
+    bool done_;
+};
+
+// begin() and end() of a stage, an iterator is valid while the stage lives
+template <typename Stage>
+class stage {
+public:
+    stage_iterator<Stage> begin()
+    {
+        return stage_iterator<Stage>(static_cast<Stage*>(this));
+    }
+
+    stage_iterator<Stage> end()
+    {
+        return stage_iterator<Stage>();
+    }
+};
+
+template <typename Co, typename Proj>
+class range : public stage<range<Co, Proj>> {
+public:
+    using iterator = stage_iterator<range>;
+
+    range(const Co& co, Proj proj)
+        : co_(co)
+        , proj_(proj)
+    {
+    }
+
+    // run to the next yield
+    bool next()
+    {
+        cogo_resume(&co_);
+        return CO_STATE(&co_) != -1;
+    }
+
+    auto value() const -> decltype(std::declval<const Proj&>()(std::declval<const Co&>()))
+    {
+        return proj_(co_);
+    }
+
+    // the coroutine, e.g. to read the result after the loop
+    const Co& get() const
+    {
+        return co_;
+    }
+
+private:
+    Co co_;
+    Proj proj_;
+};
+
+template <typename Co>
+range<Co, identity> generate(const Co& co = Co())
+{
+    return range<Co, identity>(co, identity());
+}
+
+template <typename Co, typename T>
+range<Co, field<Co, T>> generate(T Co::*p, const Co& co = Co())
+{
+    return range<Co, field<Co, T>>(co, field<Co, T>{p});
+}
+
+template <typename Co, typename T>
+range<Co, field<Co, T>> generate(const Co& co, T Co::*p)
+{
+    return range<Co, field<Co, T>>(co, field<Co, T>{p});
+}
+
+// contiguous elements handed out by batch()
+template <typename T>
+struct span {
+    const T* data;
+    std::size_t size;
+
+    const T* begin() const
+    {
+        return data;
+    }
+
+    const T* end() const
+    {
+        return data + size;
+    }
+
+    const T& operator[](std::size_t i) const
+    {
+        return data[i];
+    }
+};
+
+// f is called once per element in next(), the result is kept for value()
+template <typename Src, typename F>
+class map_stage : public stage<map_stage<Src, F>> {
+public:
+    using value_type = typename std::decay<decltype(std::declval<F&>()(std::declval<Src&>().value()))>::type;
+
+    map_stage(Src src, F f)
+        : src_(std::move(src))
+        , f_(std::move(f))
+    {
+    }
+
+    bool next()
+    {
+        if (!src_.next()) {
+            return false;
+        }
+        v_ = f_(src_.value());
+        return true;
+    }
+
+    const value_type& value() const
+    {
+        return v_;
+    }
+
+private:
+    Src src_;
+    F f_;
+    value_type v_ {};
+};
+
+template <typename Src, typename Pred>
+class filter_stage : public stage<filter_stage<Src, Pred>> {
+public:
+    filter_stage(Src src, Pred pred)
+        : src_(std::move(src))
+        , pred_(std::move(pred))
+    {
+    }
+
+    bool next()
+    {
+        while (src_.next()) {
+            if (pred_(src_.value())) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    auto value() -> decltype(std::declval<Src&>().value())
+    {
+        return src_.value();
+    }
+
+private:
+    Src src_;
+    Pred pred_;
+};
+
+// the source isn't resumed after n elements
+template <typename Src>
+class take_stage : public stage<take_stage<Src>> {
+public:
+    take_stage(Src src, std::size_t n)
+        : src_(std::move(src))
+        , n_(n)
+    {
+    }
+
+    bool next()
+    {
+        if (n_ == 0) {
+            return false;
+        }
+        n_--;
+        return src_.next();
+    }
+
+    auto value() -> decltype(std::declval<Src&>().value())
+    {
+        return src_.value();
+    }
+
+private:
+    Src src_;
+    std::size_t n_;
+};
+
+// up to N elements copied into an array, the last batch may be shorter. Not faster than the element loop.
+template <typename Src, std::size_t N>
+class batch_stage : public stage<batch_stage<Src, N>> {
+public:
+    using value_type = typename std::decay<decltype(std::declval<Src&>().value())>::type;
+
+    batch_stage(Src src)
+        : src_(std::move(src))
+    {
+    }
+
+    bool next()
+    {
+        std::size_t n = 0;
+        while (n < N && src_.next()) {
+            buf_[n++] = src_.value();
+        }
+        size_ = n;
+        return n > 0;
+    }
+
+    span<value_type> value() const
+    {
+        return span<value_type>{buf_, size_};
+    }
+
+private:
+    Src src_;
+    std::size_t size_ = 0;
+    value_type buf_[N];
+};
+
+// ends with the shorter one
+template <typename A, typename B>
+class zip_stage : public stage<zip_stage<A, B>> {
+public:
+    using value_type = std::pair<decltype(std::declval<A&>().value()), decltype(std::declval<B&>().value())>;
+
+    zip_stage(A a, B b)
+        : a_(std::move(a))
+        , b_(std::move(b))
+    {
+    }
+
+    bool next()
+    {
+        return a_.next() && b_.next();
+    }
+
+    value_type value()
+    {
+        return value_type(a_.value(), b_.value());
+    }
+
+private:
+    A a_;
+    B b_;
+};
+
+// operators applied by |
+template <typename F>
+struct map_op {
+    F f;
+};
+
+template <typename Pred>
+struct filter_op {
+    Pred pred;
+};
+
+struct take_op {
+    std::size_t n;
+};
+
+template <std::size_t N>
+struct batch_op {
+};
+
+template <typename F>
+map_op<F> map(F f)
+{
+    return map_op<F>{std::move(f)};
+}
+
+template <typename Pred>
+filter_op<Pred> filter(Pred pred)
+{
+    return filter_op<Pred>{std::move(pred)};
+}
+
+inline take_op take(std::size_t n)
+{
+    return take_op{n};
+}
+
+template <std::size_t N>
+batch_op<N> batch()
+{
+    return batch_op<N>();
+}
+
+template <typename Src, typename F>
+map_stage<typename std::decay<Src>::type, F> operator|(Src&& src, map_op<F> op)
+{
+    return map_stage<typename std::decay<Src>::type, F>(std::forward<Src>(src), std::move(op.f));
+}
+
+template <typename Src, typename Pred>
+filter_stage<typename std::decay<Src>::type, Pred> operator|(Src&& src, filter_op<Pred> op)
+{
+    return filter_stage<typename std::decay<Src>::type, Pred>(std::forward<Src>(src), std::move(op.pred));
+}
+
+template <typename Src>
+take_stage<typename std::decay<Src>::type> operator|(Src&& src, take_op op)
+{
+    return take_stage<typename std::decay<Src>::type>(std::forward<Src>(src), op.n);
+}
+
+template <typename Src, std::size_t N>
+batch_stage<typename std::decay<Src>::type, N> operator|(Src&& src, batch_op<N>)
+{
+    return batch_stage<typename std::decay<Src>::type, N>(std::forward<Src>(src));
+}
+
+template <typename A, typename B>
+zip_stage<typename std::decay<A>::type, typename std::decay<B>::type> zip(A&& a, B&& b)
+{
+    return zip_stage<typename std::decay<A>::type, typename std::decay<B>::type>(std::forward<A>(a), std::forward<B>(b));
+}
+
+} // namespace cogo
+
+#endif // MOXITREL_COGO_CO_RANGE_HPP_
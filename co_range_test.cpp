@@ -0,0 +1,161 @@
+#include <assert.h>
+#include "co_st.h"
+#include "co_range.hpp"
+#include "gtest/gtest.h"
+#include <vector>
+
+CO_DECLARE(static Nat, int value)
+{
+CO_BEGIN:
+
+    for (;; ((Nat*)CO_THIS)->value++) {
+        CO_YIELD;
+    }
+
+CO_END:;
+}
+
+// yield from .from to .to, then finish
+CO_DECLARE(static Range, int from, int to, int v)
+{
+    auto* thiz = (Range*)CO_THIS;
+CO_BEGIN:
+
+    for (thiz->v = thiz->from; thiz->v < thiz->to; thiz->v++) {
+        CO_YIELD;
+    }
+
+CO_END:;
+}
+
+TEST(Range, Infinite)
+{
+    std::vector<int> got;
+    for (int v : cogo::generate<Nat>(&Nat::value)) {
+        if (v == 5) {
+            break;
+        }
+        got.push_back(v);
+    }
+    EXPECT_EQ(got, std::vector<int>({0, 1, 2, 3, 4}));
+}
+
+TEST(Range, Finite)
+{
+    std::vector<int> got;
+    for (int v : cogo::generate(CO_MAKE(Range, 3, 6), &Range::v)) {
+        got.push_back(v);
+    }
+    EXPECT_EQ(got, std::vector<int>({3, 4, 5}));
+
+    // finished without yield
+    for (int v : cogo::generate(CO_MAKE(Range, 6, 3), &Range::v)) {
+        ADD_FAILURE() << v;
+    }
+}
+
+TEST(Range, Coroutine)
+{
+    int sum = 0;
+    auto range = cogo::generate(CO_MAKE(Range, 0, 4));
+    for (const Range& co : range) {
+        EXPECT_GT(CO_STATE(&co), 0);
+        sum += co.v;
+    }
+    EXPECT_EQ(sum, 0 + 1 + 2 + 3);
+    EXPECT_EQ(CO_STATE(&range.get()), -1);
+}
+
+// count resumes
+CO_DECLARE(static Count, int value, int* resumed)
+{
+    auto* thiz = (Count*)CO_THIS;
+CO_BEGIN:
+
+    for (;; thiz->value++) {
+        (*thiz->resumed)++;
+        CO_YIELD;
+    }
+
+CO_END:;
+}
+
+TEST(Pipeline, MapFilterTake)
+{
+    int resumed = 0;
+    std::vector<int> got;
+    auto pipe = cogo::generate(CO_MAKE(Count, 0, &resumed), &Count::value)
+              | cogo::map([](int v) { return v * v; })
+              | cogo::filter([](int v) { return v % 2 != 0; })
+              | cogo::take(4);
+    for (int v : pipe) {
+        got.push_back(v);
+    }
+    EXPECT_EQ(got, std::vector<int>({1, 9, 25, 49}));
+    // once per element, not after the last taken
+    EXPECT_EQ(resumed, 8);
+}
+
+TEST(Pipeline, Batch)
+{
+    std::vector<size_t> sizes;
+    int sum = 0;
+    for (cogo::span<int> b : cogo::generate(CO_MAKE(Range, 0, 10), &Range::v) | cogo::batch<4>()) {
+        sizes.push_back(b.size);
+        for (int v : b) {
+            sum += v;
+        }
+    }
+    EXPECT_EQ(sizes, std::vector<size_t>({4, 4, 2}));
+    EXPECT_EQ(sum, 45);
+
+    // finished without yield
+    for (cogo::span<int> b : cogo::generate(CO_MAKE(Range, 6, 3), &Range::v) | cogo::batch<4>()) {
+        ADD_FAILURE() << b.size;
+    }
+}
+
+TEST(Pipeline, Zip)
+{
+    std::vector<int> got;
+    auto pipe = cogo::zip(cogo::generate<Nat>(&Nat::value),
+                          cogo::generate(CO_MAKE(Range, 10, 13), &Range::v) | cogo::map([](int v) { return -v; }));
+    for (auto p : pipe) {
+        got.push_back(p.first + p.second);
+    }
+    EXPECT_EQ(got, std::vector<int>({-10, -10, -10}));
+}
+
+// the mapped value is computed once, not again by filter and the loop
+TEST(Pipeline, MapOnce)
+{
+    int calls = 0;
+    int sum = 0;
+    auto pipe = cogo::generate(CO_MAKE(Range, 0, 10), &Range::v)
+              | cogo::map([&calls](int v) { calls++; return v * 3; })
+              | cogo::filter([](int v) { return v % 2 == 0; });
+    for (int v : pipe) {
+        sum += v;
+    }
+    EXPECT_EQ(sum, 60);
+    EXPECT_EQ(calls, 10);
+}
+
+TEST(Range, End)
+{
+    auto range = cogo::generate(CO_MAKE(Range, 0, 2), &Range::v);
+    auto end = range.end();
+    EXPECT_TRUE(end == range.end());
+    EXPECT_FALSE(end != range.end());
+
+    auto it = range.begin();
+    EXPECT_FALSE(it == end);
+    EXPECT_FALSE(end == it);
+    EXPECT_TRUE(it != end);
+    EXPECT_TRUE(end != it);
+
+    ++it;
+    ++it;
+    EXPECT_TRUE(it == end);
+    EXPECT_TRUE(end == it);
+}
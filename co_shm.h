@@ -0,0 +1,474 @@
+/* Channel between processes in shared memory, lock-free ring of fixed-size slots, futex wakeups
+
+* API
+co_shm_chan_t                                       : channel type, placed in memory shared by processes
+co_shm_chan_size(size_t cap, size_t msg_size)       : bytes needed by a channel of cap (power of 2) messages, msg_size bytes max each
+co_shm_chan_init(void*, size_t cap, size_t msg_size): make a channel in the memory (once, by any process), return it
+CO_SHM_WRITE(co_shm_chan_t*, const void*, size_t)   : send size_t bytes, park while the channel full, dropped if over msg_size
+CO_SHM_READ (co_shm_chan_t*, void*, size_t, size_t*): receive a message into void* of size_t bytes, its length stored in size_t*,
+                                                      the messages longer than size_t dropped
+CO_SHM_RESERVE(co_shm_chan_t*, void**)              : park until a slot free, its message (msg_size bytes) stored in void**,
+                                                      publish it by co_shm_chan_commit()
+CO_SHM_PEEK (co_shm_chan_t*, const void**, size_t*) : park until a message, stored in const void** in place, its length in
+                                                      size_t*, free it by co_shm_chan_release()
+co_shm_chan_try_write(co_shm_chan_t*, const void*, size_t)          : CO_SHM_WRITE without parking, return 0, or -1 if full
+                                                                      or over msg_size
+co_shm_chan_try_read (co_shm_chan_t*, void*, size_t, size_t*)       : CO_SHM_READ  without parking, return 0, -1 if empty,
+                                                                      or -2 if the message dropped
+co_shm_chan_reserve  (co_shm_chan_t*)                               : CO_SHM_RESERVE without parking, NULL if full
+co_shm_chan_commit   (co_shm_chan_t*, void*, size_t)                : publish the reserved message of size_t bytes
+co_shm_chan_peek     (co_shm_chan_t*, size_t*)                      : CO_SHM_PEEK without parking, NULL if empty
+co_shm_chan_release  (co_shm_chan_t*, const void*)                  : free the slot of the peeked message
+
+co_shm_t                                            : scheduler waiting on shared channels when idle, inherit co_sch_t
+co_shm_init(co_shm_t*)                              : ...
+co_shm_run (co_shm_t*, co_t*)                       : run the coroutine until all finished, sleep on channels when idle
+
+* Example
+int fd = memfd_create("chan", 0);                   // or shm_open()
+ftruncate(fd, co_shm_chan_size(1024, 64));
+co_shm_chan_t* chan = co_shm_chan_init(mmap(NULL, co_shm_chan_size(1024, 64), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0), 1024, 64);
+// fork(), or pass fd to the other process and mmap() it there
+
+CO_DECLARE(Recv, co_shm_chan_t* chan, char buf[64], size_t len)
+{
+CO_BEGIN:
+
+    CO_SHM_READ(((Recv*)CO_THIS)->chan, ((Recv*)CO_THIS)->buf, 64, &((Recv*)CO_THIS)->len);
+
+CO_END:;
+}
+
+co_shm_t shm;
+co_shm_init(&shm);
+co_shm_run(&shm, &recv);
+
+* Note
+- A bounded MPMC queue (Dmitry Vyukov) with a sequence number per slot, any number of readers and writers in any processes.
+- Messages are copied into and out of the slots, or built and read in place by reserve/commit and peek/release,
+  no syscall unless a process sleeps on the channel.
+- A reserved or peeked slot holds back the readers or writers after it, commit or release it soon.
+- The peer isn't trusted with the lengths, a message longer than msg_size is dropped, nothing copied beyond.
+- The coroutines using CO_SHM_READ/CO_SHM_WRITE must be run by co_shm_run(). A coroutine parked on a channel is resumed
+  when the channel is polled ready, every COGO_SHM_POLL_STEPS steps or when idle, after sleeping on the futex words of
+  all waited channels (cogo_futex_wait_any()).
+- A scheduler waits on at most COGO_SHM_WATCH channel sides, the coroutines beyond spin (yield and retry).
+- The channel has no pointers, it may be mapped at different addresses by each process.
+
+*/
+#ifndef MOXITREL_COGO_CO_SHM_H_
+#define MOXITREL_COGO_CO_SHM_H_
+
+#include "co_st.h"
+#include <limits.h>
+#include <stdint.h>
+#include <string.h>
+
+// max channel sides waited by a scheduler
+#ifndef COGO_SHM_WATCH
+#   define COGO_SHM_WATCH       16
+#endif
+
+// poll waited channels every steps
+#ifndef COGO_SHM_POLL_STEPS
+#   define COGO_SHM_POLL_STEPS  64
+#endif
+
+#define COGO_SHM_LINE           64
+
+typedef struct {
+    // position of the message, or position + cap when free, atomic
+    uint64_t seq;
+    uint32_t len;
+    uint32_t pad;
+    // the message follows
+} cogo_shm_slot_t;
+
+typedef struct {
+    // bumped when woken, futex word
+    int seq;
+    // processes sleeping on seq
+    int sleepers;
+} cogo_shm_event_t;
+
+typedef struct co_shm_chan {
+    // const after co_shm_chan_init()
+    uint32_t mask;
+    uint32_t msg_size;
+    // bytes per slot, header included
+    uint32_t stride;
+    // next position to write, atomic
+    __attribute__((aligned(COGO_SHM_LINE))) uint64_t head;
+    // next position to read, atomic
+    __attribute__((aligned(COGO_SHM_LINE))) uint64_t tail;
+    // readers sleeping on empty, writers sleeping on full
+    __attribute__((aligned(COGO_SHM_LINE))) cogo_shm_event_t readable;
+    cogo_shm_event_t writable;
+    // slots follow
+} co_shm_chan_t;
+
+static inline size_t cogo_shm_stride(size_t msg_size)
+{
+    return (sizeof(cogo_shm_slot_t) + msg_size + 7) & ~(size_t)7;
+}
+
+static inline cogo_shm_slot_t* cogo_shm_slot(co_shm_chan_t* chan, uint64_t pos)
+{
+    return (cogo_shm_slot_t*)((char*)chan + sizeof(co_shm_chan_t) + (size_t)(pos & chan->mask) * chan->stride);
+}
+
+static inline size_t co_shm_chan_size(size_t cap, size_t msg_size)
+{
+    return sizeof(co_shm_chan_t) + cap * cogo_shm_stride(msg_size);
+}
+
+static inline co_shm_chan_t* co_shm_chan_init(void* mem, size_t cap, size_t msg_size)
+{
+    COGO_ASSERT(mem);
+    COGO_ASSERT(((uintptr_t)mem & (COGO_SHM_LINE - 1)) == 0);
+    COGO_ASSERT(cap > 0 && (cap & (cap - 1)) == 0 && cap <= UINT32_MAX);
+    COGO_ASSERT(msg_size <= UINT32_MAX);
+
+    co_shm_chan_t* chan = (co_shm_chan_t*)mem;
+    memset(chan, 0, sizeof(*chan));
+    chan->mask = (uint32_t)(cap - 1);
+    chan->msg_size = (uint32_t)msg_size;
+    chan->stride = (uint32_t)cogo_shm_stride(msg_size);
+    for (uint64_t i = 0; i < cap; i++) {
+        cogo_shm_slot(chan, i)->seq = i;
+    }
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    return chan;
+}
+
+// wake sleeping processes, after a slot published or freed
+static inline void cogo_shm_notify(cogo_shm_event_t* ev)
+{
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);    // order the slot before sleepers, see co_shm_poll()
+    if (__atomic_load_n(&ev->sleepers, __ATOMIC_RELAXED) > 0) {
+        __atomic_add_fetch(&ev->seq, 1, __ATOMIC_SEQ_CST);
+        cogo_futex_wake(&ev->seq, INT_MAX, 1);
+    }
+}
+
+// a message is ready to read
+static inline bool cogo_shm_readable(co_shm_chan_t* chan)
+{
+    uint64_t pos = __atomic_load_n(&chan->tail, __ATOMIC_RELAXED);
+    return __atomic_load_n(&cogo_shm_slot(chan, pos)->seq, __ATOMIC_ACQUIRE) == pos + 1;
+}
+
+// a slot is free to write
+static inline bool cogo_shm_writable(co_shm_chan_t* chan)
+{
+    uint64_t pos = __atomic_load_n(&chan->head, __ATOMIC_RELAXED);
+    return __atomic_load_n(&cogo_shm_slot(chan, pos)->seq, __ATOMIC_ACQUIRE) == pos;
+}
+
+// claim the next slot to write, return its message (msg_size bytes), or NULL if full. Publish it by co_shm_chan_commit().
+static inline void* co_shm_chan_reserve(co_shm_chan_t* chan)
+{
+    COGO_ASSERT(chan);
+
+    uint64_t pos = __atomic_load_n(&chan->head, __ATOMIC_RELAXED);
+    for (;;) {
+        cogo_shm_slot_t* slot = cogo_shm_slot(chan, pos);
+        int64_t dif = (int64_t)(__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) - pos);
+        if (dif == 0) {
+            if (__atomic_compare_exchange_n(&chan->head, &pos, pos + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                return slot + 1;
+            }
+        } else if (dif < 0) {
+            return NULL;
+        } else {
+            pos = __atomic_load_n(&chan->head, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+// publish the reserved message of len bytes, cut to msg_size
+static inline void co_shm_chan_commit(co_shm_chan_t* chan, void* msg, size_t len)
+{
+    COGO_ASSERT(chan);
+    COGO_ASSERT(msg);
+    COGO_ASSERT(len <= chan->msg_size);
+
+    cogo_shm_slot_t* slot = (cogo_shm_slot_t*)msg - 1;
+    // seq stays the position while the slot is claimed
+    uint64_t pos = __atomic_load_n(&slot->seq, __ATOMIC_RELAXED);
+    slot->len = (uint32_t)(len <= chan->msg_size ? len : chan->msg_size);
+    __atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+    cogo_shm_notify(&chan->readable);
+}
+
+// claim the next message to read, return it and its length stored in *len, or NULL if empty.
+// Free the slot by co_shm_chan_release(). A length over msg_size (set by a broken peer) is dropped.
+static inline const void* co_shm_chan_peek(co_shm_chan_t* chan, size_t* len)
+{
+    COGO_ASSERT(chan);
+    COGO_ASSERT(len);
+
+    uint64_t pos = __atomic_load_n(&chan->tail, __ATOMIC_RELAXED);
+    for (;;) {
+        cogo_shm_slot_t* slot = cogo_shm_slot(chan, pos);
+        int64_t dif = (int64_t)(__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) - (pos + 1));
+        if (dif == 0) {
+            if (__atomic_compare_exchange_n(&chan->tail, &pos, pos + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                // read once, the peer may still write it
+                uint32_t n = __atomic_load_n(&slot->len, __ATOMIC_RELAXED);
+                if (n <= chan->msg_size) {
+                    *len = n;
+                    return slot + 1;
+                }
+                __atomic_store_n(&slot->seq, pos + chan->mask + 1, __ATOMIC_RELEASE);
+                cogo_shm_notify(&chan->writable);
+                pos = __atomic_load_n(&chan->tail, __ATOMIC_RELAXED);
+            }
+        } else if (dif < 0) {
+            return NULL;
+        } else {
+            pos = __atomic_load_n(&chan->tail, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+// free the slot of the message by co_shm_chan_peek()
+static inline void co_shm_chan_release(co_shm_chan_t* chan, const void* msg)
+{
+    COGO_ASSERT(chan);
+    COGO_ASSERT(msg);
+
+    cogo_shm_slot_t* slot = (cogo_shm_slot_t*)msg - 1;
+    uint64_t pos = __atomic_load_n(&slot->seq, __ATOMIC_RELAXED) - 1;
+    __atomic_store_n(&slot->seq, pos + chan->mask + 1, __ATOMIC_RELEASE);
+    cogo_shm_notify(&chan->writable);
+}
+
+// return 0, or -1 if full or len over msg_size
+static inline int co_shm_chan_try_write(co_shm_chan_t* chan, const void* msg, size_t len)
+{
+    COGO_ASSERT(chan);
+
+    if (len > chan->msg_size) {
+        return -1;
+    }
+    void* slot = co_shm_chan_reserve(chan);
+    if (!slot) {
+        return -1;
+    }
+    memcpy(slot, msg, len);
+    co_shm_chan_commit(chan, slot, len);
+    return 0;
+}
+
+// return 0, -1 if empty, or -2 if the message is over cap bytes (dropped)
+static inline int co_shm_chan_try_read(co_shm_chan_t* chan, void* msg, size_t cap, size_t* len)
+{
+    COGO_ASSERT(chan);
+    COGO_ASSERT(msg);
+
+    size_t n;
+    const void* slot = co_shm_chan_peek(chan, &n);
+    if (!slot) {
+        return -1;
+    }
+    if (n > cap) {
+        co_shm_chan_release(chan, slot);
+        return -2;
+    }
+    memcpy(msg, slot, n);
+    co_shm_chan_release(chan, slot);
+    if (len) {
+        *len = n;
+    }
+    return 0;
+}
+
+// coroutines parked on a side of a channel
+typedef struct {
+    co_shm_chan_t* chan;
+    // 0: wait readable, 1: wait writable
+    int write;
+    co_queue_t q;
+} cogo_shm_watch_t;
+
+typedef struct {
+    // inherit co_sch_t
+    co_sch_t sch;
+    cogo_shm_watch_t watch[COGO_SHM_WATCH];
+    int nwatch;
+} co_shm_t;
+
+static inline void co_shm_init(co_shm_t* shm)
+{
+    COGO_ASSERT(shm);
+    *shm = (co_shm_t){.nwatch = 0};
+}
+
+static inline bool cogo_shm_watch_ready(const cogo_shm_watch_t* w)
+{
+    return w->write ? cogo_shm_writable(w->chan) : cogo_shm_readable(w->chan);
+}
+
+static inline cogo_shm_event_t* cogo_shm_watch_event(const cogo_shm_watch_t* w)
+{
+    return w->write ? &w->chan->writable : &w->chan->readable;
+}
+
+// park the coroutine on a channel side, return 1 (yield)
+static inline int cogo_shm_park(co_t* co, co_shm_chan_t* chan, int write)
+{
+    co_shm_t* shm = (co_shm_t*)((cogo_co_t*)co)->sch;
+    cogo_shm_watch_t* w = NULL;
+    for (int i = 0; i < shm->nwatch; i++) {
+        if (shm->watch[i].chan == chan && shm->watch[i].write == write) {
+            w = &shm->watch[i];
+            break;
+        }
+    }
+    if (!w) {
+        if (shm->nwatch == COGO_SHM_WATCH) {
+            return 1;   // spin
+        }
+        w = &shm->watch[shm->nwatch++];
+        *w = (cogo_shm_watch_t){.chan = chan, .write = write};
+    }
+    co_queue_push(&w->q, offsetof(co_t, next), co);
+    shm->sch.cogo_sch.stack_top = NULL;
+    return 1;
+}
+
+// CO_SHM_WRITE(co_shm_chan_t*, const void*, size_t);
+#define CO_SHM_WRITE(CHAN, MSG, LEN)                                                    \
+do {                                                                                    \
+    while (cogo_shm_write((co_t*)(CO_THIS), (CHAN), (MSG), (LEN)) != 0) {               \
+        CO_YIELD;                                                                       \
+    }                                                                                   \
+} while (0)
+static inline int cogo_shm_write(co_t* co, co_shm_chan_t* chan, const void* msg, size_t len)
+{
+    COGO_ASSERT(len <= chan->msg_size);
+    if (len > chan->msg_size || co_shm_chan_try_write(chan, msg, len) == 0) {
+        return 0;   // sent, or can't be sent
+    }
+    return cogo_shm_park(co, chan, 1);
+}
+
+// CO_SHM_READ(co_shm_chan_t*, void*, size_t, size_t*);
+#define CO_SHM_READ(CHAN, MSG, CAP, LEN)                                                \
+do {                                                                                    \
+    while (cogo_shm_read((co_t*)(CO_THIS), (CHAN), (MSG), (CAP), (LEN)) != 0) {         \
+        CO_YIELD;                                                                       \
+    }                                                                                   \
+} while (0)
+static inline int cogo_shm_read(co_t* co, co_shm_chan_t* chan, void* msg, size_t cap, size_t* len)
+{
+    int r;
+    while ((r = co_shm_chan_try_read(chan, msg, cap, len)) == -2)
+    {}  // dropped, read the next
+    if (r == 0) {
+        return 0;
+    }
+    return cogo_shm_park(co, chan, 0);
+}
+
+// CO_SHM_RESERVE(co_shm_chan_t*, void**);
+#define CO_SHM_RESERVE(CHAN, PMSG)                                                      \
+do {                                                                                    \
+    while (cogo_shm_reserve((co_t*)(CO_THIS), (CHAN), (PMSG)) != 0) {                   \
+        CO_YIELD;                                                                       \
+    }                                                                                   \
+} while (0)
+static inline int cogo_shm_reserve(co_t* co, co_shm_chan_t* chan, void** pmsg)
+{
+    COGO_ASSERT(pmsg);
+    if ((*pmsg = co_shm_chan_reserve(chan)) != NULL) {
+        return 0;
+    }
+    return cogo_shm_park(co, chan, 1);
+}
+
+// CO_SHM_PEEK(co_shm_chan_t*, const void**, size_t*);
+#define CO_SHM_PEEK(CHAN, PMSG, LEN)                                                    \
+do {                                                                                    \
+    while (cogo_shm_peek((co_t*)(CO_THIS), (CHAN), (PMSG), (LEN)) != 0) {               \
+        CO_YIELD;                                                                       \
+    }                                                                                   \
+} while (0)
+static inline int cogo_shm_peek(co_t* co, co_shm_chan_t* chan, const void** pmsg, size_t* len)
+{
+    COGO_ASSERT(pmsg);
+    if ((*pmsg = co_shm_chan_peek(chan, len)) != NULL) {
+        return 0;
+    }
+    return cogo_shm_park(co, chan, 0);
+}
+
+// resume coroutines of ready channels. block: sleep until any ready if none.
+// return the number of resumed coroutines
+static inline int co_shm_poll(co_shm_t* shm, bool block)
+{
+    int n = 0;
+    for (int i = 0; i < shm->nwatch; ) {
+        cogo_shm_watch_t* w = &shm->watch[i];
+        if (!cogo_shm_watch_ready(w)) {
+            i++;
+            continue;
+        }
+        co_t* co;
+        while ((co = (co_t*)co_queue_pop(&w->q, offsetof(co_t, next))) != NULL) {
+            co_sch_fifo_push((cogo_sch_t*)&shm->sch, (cogo_co_t*)co);
+            n++;
+        }
+        *w = shm->watch[--shm->nwatch];
+    }
+    if (n > 0 || !block || shm->nwatch == 0) {
+        return n;
+    }
+
+    // announce sleepers before checking again, see cogo_shm_notify()
+    int* addrs[COGO_SHM_WATCH];
+    int vals[COGO_SHM_WATCH];
+    for (int i = 0; i < shm->nwatch; i++) {
+        cogo_shm_event_t* ev = cogo_shm_watch_event(&shm->watch[i]);
+        __atomic_add_fetch(&ev->sleepers, 1, __ATOMIC_SEQ_CST);
+        addrs[i] = &ev->seq;
+        vals[i] = __atomic_load_n(&ev->seq, __ATOMIC_SEQ_CST);
+    }
+    bool ready = false;
+    for (int i = 0; i < shm->nwatch && !ready; i++) {
+        ready = cogo_shm_watch_ready(&shm->watch[i]);
+    }
+    if (!ready) {
+        cogo_futex_wait_any(addrs, vals, shm->nwatch, 1);
+    }
+    for (int i = 0; i < shm->nwatch; i++) {
+        __atomic_sub_fetch(&cogo_shm_watch_event(&shm->watch[i])->sleepers, 1, __ATOMIC_RELAXED);
+    }
+    return co_shm_poll(shm, false);
+}
+
+static inline void co_shm_run(co_shm_t* shm, void* co)
+{
+    COGO_ASSERT(shm);
+    shm->sch.cogo_sch.stack_top = (cogo_co_t*)co;
+    for (unsigned steps = 0; ; steps++) {
+        if (shm->nwatch > 0 && steps % COGO_SHM_POLL_STEPS == 0) {
+            co_shm_poll(shm, false);
+        }
+        if (!shm->sch.cogo_sch.stack_top) {
+            shm->sch.cogo_sch.stack_top = co_sch_fifo_pop((cogo_sch_t*)&shm->sch);
+        }
+        if (shm->sch.cogo_sch.stack_top) {
+            co_sch_step(&shm->sch);
+            continue;
+        }
+        if (shm->nwatch == 0) {
+            break;
+        }
+        co_shm_poll(shm, true);
+    }
+    co_sch_destroy(&shm->sch);
+}
+
+#endif // MOXITREL_COGO_CO_SHM_H_
@@ -0,0 +1,144 @@
+// Message throughput between two processes: co_shm_chan_t vs a non-blocking socketpair run by co_io_t.
+// usage: co_shm_bench [messages]
+#include "co_io.h"
+#include "co_shm.h"
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+#define MSG_SIZE    64
+
+static long total;
+
+CO_DECLARE(static ShmWriter, co_shm_chan_t* chan, long i, char msg[MSG_SIZE])
+{
+    auto* thiz = (ShmWriter*)CO_THIS;
+CO_BEGIN:
+
+    for (; thiz->i < total; thiz->i++) {
+        memcpy(thiz->msg, &thiz->i, sizeof(thiz->i));
+        CO_SHM_WRITE(thiz->chan, thiz->msg, MSG_SIZE);
+    }
+
+CO_END:;
+}
+
+CO_DECLARE(static ShmReader, co_shm_chan_t* chan, long n, size_t len, char msg[MSG_SIZE])
+{
+    auto* thiz = (ShmReader*)CO_THIS;
+CO_BEGIN:
+
+    for (; thiz->n < total; thiz->n++) {
+        CO_SHM_READ(thiz->chan, thiz->msg, MSG_SIZE, &thiz->len);
+    }
+
+CO_END:;
+}
+
+CO_DECLARE(static SockWriter, int fd, long i, char msg[MSG_SIZE])
+{
+    auto* thiz = (SockWriter*)CO_THIS;
+CO_BEGIN:
+
+    while (thiz->i < total) {
+        memcpy(thiz->msg, &thiz->i, sizeof(thiz->i));
+        if (write(thiz->fd, thiz->msg, MSG_SIZE) < 0) {
+            CO_IO_WAIT(thiz->fd, EPOLLOUT);
+            continue;
+        }
+        thiz->i++;
+    }
+
+CO_END:;
+}
+
+CO_DECLARE(static SockReader, int fd, long n, char msg[MSG_SIZE])
+{
+    auto* thiz = (SockReader*)CO_THIS;
+CO_BEGIN:
+
+    while (thiz->n < total) {
+        if (read(thiz->fd, thiz->msg, MSG_SIZE) < 0) {
+            CO_IO_WAIT(thiz->fd, EPOLLIN);
+            continue;
+        }
+        thiz->n++;
+    }
+
+CO_END:;
+}
+
+static void report(const char* name, std::chrono::steady_clock::time_point t0, long n)
+{
+    double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    printf("%-10s %8.2f Mmsg/s %8.1f MiB/s%s\n", name, (double)n / s / 1e6, (double)n * MSG_SIZE / s / (1 << 20), n == total ? "" : " (short)");
+}
+
+static void bench_shm(void)
+{
+    size_t size = co_shm_chan_size(1024, MSG_SIZE);
+    void* mem = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED) {
+        perror("mmap");
+        exit(1);
+    }
+    co_shm_chan_t* chan = co_shm_chan_init(mem, 1024, MSG_SIZE);
+
+    auto t0 = std::chrono::steady_clock::now();
+    pid_t pid = fork();
+    if (pid == 0) {
+        co_shm_t shm;
+        co_shm_init(&shm);
+        auto writer = CO_MAKE(ShmWriter, chan);
+        co_shm_run(&shm, &writer);
+        _exit(0);
+    }
+    co_shm_t shm;
+    co_shm_init(&shm);
+    auto reader = CO_MAKE(ShmReader, chan);
+    co_shm_run(&shm, &reader);
+    report("shm", t0, reader.n);
+    waitpid(pid, NULL, 0);
+    munmap(mem, size);
+}
+
+static void bench_socketpair(void)
+{
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK, 0, fds) != 0) {
+        perror("socketpair");
+        exit(1);
+    }
+
+    auto t0 = std::chrono::steady_clock::now();
+    pid_t pid = fork();
+    if (pid == 0) {
+        close(fds[1]);
+        co_io_t io;
+        co_io_init(&io);
+        auto writer = CO_MAKE(SockWriter, fds[0]);
+        co_io_run(&io, &writer);
+        co_io_destroy(&io);
+        _exit(0);
+    }
+    close(fds[0]);
+    co_io_t io;
+    co_io_init(&io);
+    auto reader = CO_MAKE(SockReader, fds[1]);
+    co_io_run(&io, &reader);
+    report("socketpair", t0, reader.n);
+    co_io_destroy(&io);
+    waitpid(pid, NULL, 0);
+    close(fds[1]);
+}
+
+int main(int argc, char* argv[])
+{
+    total = argc > 1 ? atol(argv[1]) : 10000000;
+    bench_socketpair();
+    bench_shm();
+    return 0;
+}
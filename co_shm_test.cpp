@@ -0,0 +1,241 @@
+#include "co_shm.h"
+#include "gtest/gtest.h"
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+static co_shm_chan_t* chan_map(size_t cap, size_t msg_size)
+{
+    void* mem = mmap(NULL, co_shm_chan_size(cap, msg_size), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    return mem == MAP_FAILED ? NULL : co_shm_chan_init(mem, cap, msg_size);
+}
+
+static void chan_unmap(co_shm_chan_t* chan, size_t cap, size_t msg_size)
+{
+    munmap(chan, co_shm_chan_size(cap, msg_size));
+}
+
+TEST(Shm, TryReadWrite)
+{
+    co_shm_chan_t* chan = chan_map(4, 16);
+    ASSERT_TRUE(chan);
+
+    char buf[16];
+    size_t len = 0;
+    EXPECT_EQ(co_shm_chan_try_read(chan, buf, sizeof(buf), &len), -1);
+    for (int i = 0; i < 4; i++) {
+        EXPECT_EQ(co_shm_chan_try_write(chan, "0123456789", (size_t)i + 1), 0);
+    }
+    EXPECT_EQ(co_shm_chan_try_write(chan, "x", 1), -1);
+    for (int i = 0; i < 4; i++) {
+        ASSERT_EQ(co_shm_chan_try_read(chan, buf, sizeof(buf), &len), 0);
+        EXPECT_EQ(len, (size_t)i + 1);
+        EXPECT_EQ(memcmp(buf, "0123456789", len), 0);
+    }
+    EXPECT_EQ(co_shm_chan_try_read(chan, buf, sizeof(buf), &len), -1);
+    // wrap around
+    EXPECT_EQ(co_shm_chan_try_write(chan, "y", 1), 0);
+    ASSERT_EQ(co_shm_chan_try_read(chan, buf, sizeof(buf), &len), 0);
+    EXPECT_EQ(buf[0], 'y');
+
+    chan_unmap(chan, 4, 16);
+}
+
+TEST(Shm, Bounds)
+{
+    co_shm_chan_t* chan = chan_map(4, 16);
+    ASSERT_TRUE(chan);
+
+    char buf[32] = {};
+    size_t len = 0;
+    EXPECT_EQ(co_shm_chan_try_write(chan, buf, 17), -1);    // over msg_size
+    EXPECT_EQ(co_shm_chan_try_read(chan, buf, sizeof(buf), &len), -1);
+
+    // over the capacity of the reader, dropped
+    EXPECT_EQ(co_shm_chan_try_write(chan, "0123456789", 10), 0);
+    EXPECT_EQ(co_shm_chan_try_read(chan, buf, 4, &len), -2);
+    EXPECT_EQ(co_shm_chan_try_read(chan, buf, sizeof(buf), &len), -1);
+
+    // a length over msg_size set by a broken peer, dropped
+    void* msg = co_shm_chan_reserve(chan);
+    ASSERT_TRUE(msg);
+    co_shm_chan_commit(chan, msg, 1);
+    ((cogo_shm_slot_t*)msg - 1)->len = 1000;
+    EXPECT_EQ(co_shm_chan_try_write(chan, "y", 1), 0);
+    memset(buf, 0, sizeof(buf));
+    ASSERT_EQ(co_shm_chan_try_read(chan, buf, sizeof(buf), &len), 0);
+    EXPECT_EQ(len, 1u);
+    EXPECT_EQ(buf[0], 'y');
+    EXPECT_EQ(buf[1], 0);
+
+    chan_unmap(chan, 4, 16);
+}
+
+TEST(Shm, ZeroCopy)
+{
+    co_shm_chan_t* chan = chan_map(2, 16);
+    ASSERT_TRUE(chan);
+
+    size_t len = 0;
+    EXPECT_EQ(co_shm_chan_peek(chan, &len), nullptr);
+    char* a = (char*)co_shm_chan_reserve(chan);
+    char* b = (char*)co_shm_chan_reserve(chan);
+    ASSERT_TRUE(a && b);
+    EXPECT_EQ(co_shm_chan_reserve(chan), nullptr);          // full
+    memcpy(b, "bb", 2);
+    co_shm_chan_commit(chan, b, 2);
+    EXPECT_EQ(co_shm_chan_peek(chan, &len), nullptr);       // a not committed yet
+    memcpy(a, "a", 1);
+    co_shm_chan_commit(chan, a, 1);
+
+    const char* m = (const char*)co_shm_chan_peek(chan, &len);
+    ASSERT_EQ(m, a);                                        // in place
+    EXPECT_EQ(len, 1u);
+    EXPECT_EQ(m[0], 'a');
+    co_shm_chan_release(chan, m);
+    m = (const char*)co_shm_chan_peek(chan, &len);
+    ASSERT_EQ(m, b);
+    EXPECT_EQ(len, 2u);
+    co_shm_chan_release(chan, m);
+    EXPECT_EQ(co_shm_chan_peek(chan, &len), nullptr);
+
+    // slots free again
+    EXPECT_EQ(co_shm_chan_reserve(chan), a);
+
+    chan_unmap(chan, 2, 16);
+}
+
+CO_DECLARE(static Writer, co_shm_chan_t* chan, int n, int i)
+{
+CO_BEGIN:
+
+    for (; ((Writer*)CO_THIS)->i < ((Writer*)CO_THIS)->n; ((Writer*)CO_THIS)->i++) {
+        CO_SHM_WRITE(((Writer*)CO_THIS)->chan, &((Writer*)CO_THIS)->i, sizeof(int));
+    }
+
+CO_END:;
+}
+
+CO_DECLARE(static Reader, co_shm_chan_t* chan, int n, int value, size_t len, long sum)
+{
+CO_BEGIN:
+
+    for (; ((Reader*)CO_THIS)->n > 0; ((Reader*)CO_THIS)->n--) {
+        CO_SHM_READ(((Reader*)CO_THIS)->chan, &((Reader*)CO_THIS)->value, sizeof(int), &((Reader*)CO_THIS)->len);
+        ((Reader*)CO_THIS)->sum += ((Reader*)CO_THIS)->value;
+    }
+
+CO_END:;
+}
+
+CO_DECLARE(static Entry, Reader reader, Writer writer)
+{
+CO_BEGIN:
+
+    CO_START(&((Entry*)CO_THIS)->reader);
+    CO_START(&((Entry*)CO_THIS)->writer);
+
+CO_END:;
+}
+
+CO_DECLARE(static Producer, co_shm_chan_t* chan, int n, int i, void* msg)
+{
+    auto* thiz = (Producer*)CO_THIS;
+CO_BEGIN:
+
+    for (; thiz->i < thiz->n; thiz->i++) {
+        CO_SHM_RESERVE(thiz->chan, &thiz->msg);
+        memcpy(thiz->msg, &thiz->i, sizeof(int));
+        co_shm_chan_commit(thiz->chan, thiz->msg, sizeof(int));
+    }
+
+CO_END:;
+}
+
+CO_DECLARE(static Consumer, co_shm_chan_t* chan, int n, const void* msg, size_t len, long sum)
+{
+    auto* thiz = (Consumer*)CO_THIS;
+CO_BEGIN:
+
+    for (; thiz->n > 0; thiz->n--) {
+        CO_SHM_PEEK(thiz->chan, &thiz->msg, &thiz->len);
+        thiz->sum += *(const int*)thiz->msg;
+        co_shm_chan_release(thiz->chan, thiz->msg);
+    }
+
+CO_END:;
+}
+
+CO_DECLARE(static InPlace, Consumer consumer, Producer producer)
+{
+CO_BEGIN:
+
+    CO_START(&((InPlace*)CO_THIS)->consumer);
+    CO_START(&((InPlace*)CO_THIS)->producer);
+
+CO_END:;
+}
+
+// reserve and peek park like write and read
+TEST(Shm, ParkInPlace)
+{
+    co_shm_chan_t* chan = chan_map(2, sizeof(int));
+    ASSERT_TRUE(chan);
+
+    co_shm_t shm;
+    co_shm_init(&shm);
+    auto entry = CO_MAKE(InPlace, CO_MAKE(Consumer, chan, 100), CO_MAKE(Producer, chan, 100));
+    co_shm_run(&shm, &entry);
+
+    EXPECT_EQ(entry.consumer.sum, 99 * 100 / 2);
+    EXPECT_EQ(entry.consumer.len, sizeof(int));
+    EXPECT_EQ(shm.nwatch, 0);
+    chan_unmap(chan, 2, sizeof(int));
+}
+
+// reader and writer park on the same scheduler
+TEST(Shm, Park)
+{
+    co_shm_chan_t* chan = chan_map(2, sizeof(int));
+    ASSERT_TRUE(chan);
+
+    co_shm_t shm;
+    co_shm_init(&shm);
+    auto entry = CO_MAKE(Entry, CO_MAKE(Reader, chan, 100), CO_MAKE(Writer, chan, 100));
+    co_shm_run(&shm, &entry);
+
+    EXPECT_EQ(entry.reader.sum, 99 * 100 / 2);
+    EXPECT_EQ(entry.reader.len, sizeof(int));
+    EXPECT_EQ(shm.nwatch, 0);
+    chan_unmap(chan, 2, sizeof(int));
+}
+
+// the child writes, the parent reads, both sleep on futex when blocked
+TEST(Shm, Fork)
+{
+    const int n = 100000;
+    co_shm_chan_t* chan = chan_map(8, sizeof(int));
+    ASSERT_TRUE(chan);
+
+    pid_t pid = fork();
+    ASSERT_GE(pid, 0);
+    if (pid == 0) {
+        co_shm_t shm;
+        co_shm_init(&shm);
+        auto writer = CO_MAKE(Writer, chan, n);
+        co_shm_run(&shm, &writer);
+        _exit(writer.i == n ? 0 : 1);
+    }
+
+    co_shm_t shm;
+    co_shm_init(&shm);
+    auto reader = CO_MAKE(Reader, chan, n);
+    co_shm_run(&shm, &reader);
+    EXPECT_EQ(reader.sum, (long)(n - 1) * n / 2);
+
+    int status = 0;
+    ASSERT_EQ(waitpid(pid, &status, 0), pid);
+    EXPECT_TRUE(WIFEXITED(status));
+    EXPECT_EQ(WEXITSTATUS(status), 0);
+    chan_unmap(chan, 8, sizeof(int));
+}
@@ -0,0 +1,7 @@
+#include "co_snap.h"
+
+extern inline void cogo_snap_anchor(void);
+
+extern inline int co_snap_save(const char* path, co_t* const cos[], const size_t sizes[], size_t n);
+extern inline int co_snap_load(co_snap_t* snap, const char* path, co_t* cos[], size_t n);
+extern inline void co_snap_close(co_snap_t* snap);
@@ -0,0 +1,295 @@
+/* Snapshot coroutines to a file, and resume them in another process of the same binary.
+
+* API
+co_snap_t                                                           : a loaded snapshot, the file mapped in memory
+co_snap_save (const char*, co_t* const[], const size_t[], size_t)  : save coroutines and their frame sizes to file
+co_snap_load (co_snap_t*, const char*, co_t*[], size_t)             : map a saved file, return the coroutines in the same order
+co_snap_close(co_snap_t*)                                           : unmap the file, the loaded coroutines are gone
+
+* Example
+    // save: a session awaiting its embedded child, frame size 0 means inside another frame
+    co_t*  cos[]   = {(co_t*)session    , (co_t*)&session->child};
+    size_t sizes[] = {sizeof(*session)  , 0                     };
+    co_snap_save("session.snap", cos, sizes, 2);
+
+    // restart
+    co_snap_t snap;
+    co_t* cos[2];
+    co_snap_load(&snap, "session.snap", cos, 2);
+    co_run(cos[1]);     // continue from the child, then the session
+
+* Note
+- The links of coroutines (cogo_co_t.caller, co_t.next) are relocated, which must point into the saved frames.
+  A co_t.next points to elsewhere is dropped, as it's stale if the coroutine isn't in a run queue.
+- Other pointers in frames (e.g. co_chan_t*) aren't relocated, and should be fixed by user after loading.
+- cogo_co_t.func is saved as an offset in the binary, so a snapshot must be loaded by the same binary, at any
+  load address. Another build is refused only if it moved co_snap_load(), it's a sanity check not a build id.
+- Only the frame and link offsets are checked, those out of the file are refused before relocating. The function
+  offsets and resume states are used as saved, a forged file can run any code, load only the files saved by yourself.
+- The file is mapped privately, changes after loading aren't written back, save again to persist them.
+- Return 0 on success, or -1 with errno set.
+
+*/
+#ifndef MOXITREL_COGO_CO_SNAP_H_
+#define MOXITREL_COGO_CO_SNAP_H_
+
+#include "co_st.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define COGO_SNAP_MAGIC     "cogosnap"
+#define COGO_SNAP_VERSION   1
+#define COGO_SNAP_ALIGN     16
+
+typedef struct {
+    // the mapped file
+    void* base;
+    size_t size;
+} co_snap_t;
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    // number of coroutines
+    uint32_t n;
+    // file size
+    uint64_t size;
+    // distance between two functions, a cheap check against another build
+    int64_t build;
+} cogo_snap_head_t;
+
+typedef struct {
+    // offset of the coroutine in file
+    uint64_t off;
+    // frame size, 0 if embedded in another frame
+    uint64_t size;
+} cogo_snap_entry_t;
+
+// cogo_co_t.func is saved as an offset from this function
+inline void cogo_snap_anchor(void)
+{}
+
+inline int co_snap_load(co_snap_t* snap, const char* path, co_t* cos[], size_t n);
+
+static inline int64_t cogo_snap_build(void)
+{
+    return (int64_t)((intptr_t)&co_snap_load - (intptr_t)&cogo_snap_anchor);
+}
+
+// frame in memory, sorted by address to locate pointers
+typedef struct {
+    const char* addr;
+    uint64_t size;
+    // offset in file
+    uint64_t off;
+} cogo_snap_frame_t;
+
+static inline int cogo_snap_frame_cmp(const void* a, const void* b)
+{
+    const char* x = ((const cogo_snap_frame_t*)a)->addr;
+    const char* y = ((const cogo_snap_frame_t*)b)->addr;
+    return (x > y) - (x < y);
+}
+
+// offset in file of the pointer p, 0 if not in any frame
+static inline uint64_t cogo_snap_locate(const cogo_snap_frame_t* frames, size_t n, const void* p)
+{
+    size_t lo = 0;
+    size_t hi = n;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if ((const char*)p < frames[mid].addr) {
+            hi = mid;
+        } else if ((const char*)p >= frames[mid].addr + frames[mid].size) {
+            lo = mid + 1;
+        } else {
+            return frames[mid].off + (uint64_t)((const char*)p - frames[mid].addr);
+        }
+    }
+    return 0;
+}
+
+// write the snapshot into the mapped file, return errno
+static inline int cogo_snap_write(char* base, uint64_t size, const cogo_snap_frame_t* frames, size_t nframes,
+                                  co_t* const cos[], const size_t sizes[], size_t n)
+{
+    for (size_t i = 0; i < nframes; i++) {
+        memcpy(base + frames[i].off, frames[i].addr, frames[i].size);
+    }
+    cogo_snap_head_t* head = (cogo_snap_head_t*)base;
+    memcpy(head->magic, COGO_SNAP_MAGIC, sizeof(head->magic));
+    head->version = COGO_SNAP_VERSION;
+    head->n = (uint32_t)n;
+    head->size = size;
+    head->build = cogo_snap_build();
+
+    // relocate links
+    cogo_snap_entry_t* entries = (cogo_snap_entry_t*)(head + 1);
+    for (size_t i = 0; i < n; i++) {
+        const cogo_co_t* co = (const cogo_co_t*)cos[i];
+        uint64_t caller = co->caller ? cogo_snap_locate(frames, nframes, co->caller) : 0;
+        entries[i].off = cogo_snap_locate(frames, nframes, co);
+        entries[i].size = sizes[i];
+        if (entries[i].off == 0 || (co->caller && caller == 0)) {
+            return EINVAL;
+        }
+        co_t* saved = (co_t*)(base + entries[i].off);
+        saved->cogo_co.func = co->func ? (void (*)(void*))((intptr_t)co->func - (intptr_t)&cogo_snap_anchor) : NULL;
+        saved->cogo_co.caller = (cogo_co_t*)(intptr_t)caller;
+        saved->cogo_co.sch = NULL;
+        saved->next = (co_t*)(intptr_t)cogo_snap_locate(frames, nframes, cos[i]->next);
+    }
+    return 0;
+}
+
+inline int co_snap_save(const char* path, co_t* const cos[], const size_t sizes[], size_t n)
+{
+    COGO_ASSERT(path);
+    COGO_ASSERT(cos || n == 0);
+    COGO_ASSERT(sizes || n == 0);
+
+    cogo_snap_frame_t* frames = (cogo_snap_frame_t*)malloc((n ? n : 1) * sizeof(*frames));
+    if (!frames) {
+        return -1;
+    }
+
+    // layout: head, entries, frames
+    size_t nframes = 0;
+    uint64_t size = (sizeof(cogo_snap_head_t) + n * sizeof(cogo_snap_entry_t) + COGO_SNAP_ALIGN - 1) & ~(uint64_t)(COGO_SNAP_ALIGN - 1);
+    for (size_t i = 0; i < n; i++) {
+        if (sizes[i] > 0) {
+            frames[nframes].addr = (const char*)cos[i];
+            frames[nframes].size = sizes[i];
+            frames[nframes].off = size;
+            nframes++;
+            size += (sizes[i] + COGO_SNAP_ALIGN - 1) & ~(uint64_t)(COGO_SNAP_ALIGN - 1);
+        }
+    }
+    qsort(frames, nframes, sizeof(*frames), cogo_snap_frame_cmp);
+
+    int err = 0;
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        err = errno;
+    } else {
+        char* base = (char*)MAP_FAILED;
+        if (ftruncate(fd, (off_t)size) != 0
+        || (base = (char*)mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED) {
+            err = errno;
+        } else {
+            err = cogo_snap_write(base, size, frames, nframes, cos, sizes, n);
+            if (err == 0 && msync(base, size, MS_SYNC) != 0) {
+                err = errno;
+            }
+            munmap(base, size);
+        }
+        close(fd);
+    }
+    free(frames);
+    if (err != 0) {
+        errno = err;
+        return -1;
+    }
+    return 0;
+}
+
+// [off, off + len) lies after the head and entries, inside the file
+static inline bool cogo_snap_inside(uint64_t begin, uint64_t size, uint64_t off, uint64_t len)
+{
+    return off >= begin && off <= size && len <= size - off;
+}
+
+// check the frame and link offsets of the mapped file before relocating, not func or the resume states
+static inline bool cogo_snap_check(const char* base, uint64_t size, size_t n)
+{
+    const cogo_snap_head_t* head = (const cogo_snap_head_t*)base;
+    const cogo_snap_entry_t* entries = (const cogo_snap_entry_t*)(head + 1);
+    if (size < sizeof(*head)
+    ||  memcmp(head->magic, COGO_SNAP_MAGIC, sizeof(head->magic)) != 0
+    ||  head->version != COGO_SNAP_VERSION
+    ||  head->size != size
+    ||  head->build != cogo_snap_build()
+    ||  head->n != n
+    ||  n > (size - sizeof(*head)) / sizeof(*entries)) {
+        return false;
+    }
+
+    uint64_t begin = sizeof(*head) + n * sizeof(*entries);
+    for (size_t i = 0; i < n; i++) {
+        uint64_t off = entries[i].off;
+        if (!cogo_snap_inside(begin, size, off, entries[i].size > sizeof(co_t) ? entries[i].size : sizeof(co_t))
+        ||  off % sizeof(void*) != 0) {
+            return false;
+        }
+        const co_t* co = (const co_t*)(base + off);
+        uint64_t caller = (uint64_t)(uintptr_t)co->cogo_co.caller;
+        uint64_t next = (uint64_t)(uintptr_t)co->next;
+        if ((caller && (!cogo_snap_inside(begin, size, caller, sizeof(co_t)) || caller % sizeof(void*) != 0))
+        ||  (next && (!cogo_snap_inside(begin, size, next, sizeof(co_t)) || next % sizeof(void*) != 0))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+inline int co_snap_load(co_snap_t* snap, const char* path, co_t* cos[], size_t n)
+{
+    COGO_ASSERT(snap);
+    COGO_ASSERT(path);
+    COGO_ASSERT(cos || n == 0);
+
+    struct stat st;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+    if (fstat(fd, &st) != 0) {
+        int err = errno;
+        close(fd);
+        errno = err;
+        return -1;
+    }
+    char* base = (char*)mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    int err = errno;
+    close(fd);
+    if (base == MAP_FAILED) {
+        errno = err;
+        return -1;
+    }
+
+    const cogo_snap_entry_t* entries = (const cogo_snap_entry_t*)((const cogo_snap_head_t*)base + 1);
+    if (!cogo_snap_check(base, (uint64_t)st.st_size, n)) {
+        munmap(base, (size_t)st.st_size);
+        errno = EINVAL;
+        return -1;
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        co_t* co = (co_t*)(base + entries[i].off);
+        intptr_t func = (intptr_t)co->cogo_co.func;
+        co->cogo_co.func = func ? (void (*)(void*))((intptr_t)&cogo_snap_anchor + func) : NULL;
+        co->cogo_co.caller = co->cogo_co.caller ? (cogo_co_t*)(base + (intptr_t)co->cogo_co.caller) : NULL;
+        co->next = co->next ? (co_t*)(base + (intptr_t)co->next) : NULL;
+        cos[i] = co;
+    }
+    snap->base = base;
+    snap->size = (size_t)st.st_size;
+    return 0;
+}
+
+inline void co_snap_close(co_snap_t* snap)
+{
+    COGO_ASSERT(snap);
+    if (snap->base) {
+        munmap(snap->base, snap->size);
+        snap->base = NULL;
+    }
+}
+
+#endif // MOXITREL_COGO_CO_SNAP_H_
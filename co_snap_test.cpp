@@ -0,0 +1,198 @@
+#include <assert.h>
+#include "co_snap.h"
+#include "gtest/gtest.h"
+#include <stdio.h>
+#include <string>
+#include <sys/wait.h>
+#include <vector>
+
+CO_DECLARE(static Counter, int i, int sum)
+{
+    auto* thiz = (Counter*)CO_THIS;
+CO_BEGIN:
+
+    for (thiz->i = 1; thiz->i <= 10; thiz->i++) {
+        thiz->sum += thiz->i;
+        CO_YIELD;
+    }
+
+CO_END:;
+}
+
+CO_DECLARE(static Session, Counter counter, int result)
+{
+    auto* thiz = (Session*)CO_THIS;
+CO_BEGIN:
+
+    CO_AWAIT(&thiz->counter);
+    thiz->result = thiz->counter.sum * 2;
+
+CO_END:;
+}
+
+TEST(Snap, SaveLoad)
+{
+    const std::string path = testing::TempDir() + "co_snap_test_save_load.snap";
+    auto session = CO_MAKE(Session, CO_MAKE(Counter));
+    co_sch_t sch = {};
+    sch.cogo_sch.stack_top = (cogo_co_t*)&session;
+    for (int i = 0; i < 4; i++) {
+        co_sch_step(&sch);
+    }
+    co_sch_destroy(&sch);
+    ASSERT_EQ(sch.cogo_sch.stack_top, (cogo_co_t*)&session.counter);
+
+    co_t* cos[] = {(co_t*)&session, (co_t*)&session.counter};
+    size_t sizes[] = {sizeof(session), 0};
+    ASSERT_EQ(co_snap_save(path.c_str(), cos, sizes, 2), 0);
+
+    // finish the original
+    co_run(sch.cogo_sch.stack_top);
+    EXPECT_EQ(session.result, 110);
+
+    // continue the saved one
+    co_snap_t snap;
+    co_t* loaded[2];
+    ASSERT_EQ(co_snap_load(&snap, path.c_str(), loaded, 2), 0);
+    auto* session2 = (Session*)loaded[0];
+    EXPECT_EQ(loaded[1], (co_t*)&session2->counter);
+    EXPECT_EQ(((cogo_co_t*)loaded[1])->caller, (cogo_co_t*)session2);
+    EXPECT_EQ(((cogo_co_t*)loaded[1])->func, Counter_func);
+    EXPECT_EQ(session2->counter.sum, 1 + 2 + 3 + 4);
+    EXPECT_EQ(session2->result, 0);
+
+    co_run(loaded[1]);
+    EXPECT_EQ(session2->result, 110);
+    co_snap_close(&snap);
+}
+
+TEST(Snap, Refuse)
+{
+    const std::string path = testing::TempDir() + "co_snap_test_refuse.snap";
+    auto session = CO_MAKE(Session, CO_MAKE(Counter));
+    Counter other = CO_MAKE(Counter);
+
+    // caller points outside of the saved frames
+    other.co.cogo_co.caller = (cogo_co_t*)&session;
+    co_t* cos[] = {(co_t*)&other};
+    size_t sizes[] = {sizeof(other)};
+    EXPECT_EQ(co_snap_save(path.c_str(), cos, sizes, 1), -1);
+    EXPECT_EQ(errno, EINVAL);
+
+    // count mismatch
+    other.co.cogo_co.caller = NULL;
+    ASSERT_EQ(co_snap_save(path.c_str(), cos, sizes, 1), 0);
+    co_snap_t snap;
+    co_t* loaded[2];
+    EXPECT_EQ(co_snap_load(&snap, path.c_str(), loaded, 2), -1);
+    EXPECT_EQ(errno, EINVAL);
+}
+
+// overwrite bytes of a saved file
+static void patch(const std::string& path, long off, const void* data, size_t size)
+{
+    FILE* f = fopen(path.c_str(), "r+b");
+    ASSERT_NE(f, nullptr);
+    ASSERT_EQ(fseek(f, off, SEEK_SET), 0);
+    ASSERT_EQ(fwrite(data, size, 1, f), 1u);
+    fclose(f);
+}
+
+// offsets out of the file are refused before relocating
+TEST(Snap, Corrupt)
+{
+    const std::string path = testing::TempDir() + "co_snap_test_corrupt.snap";
+    auto session = CO_MAKE(Session, CO_MAKE(Counter));
+    co_t* cos[] = {(co_t*)&session, (co_t*)&session.counter};
+    size_t sizes[] = {sizeof(session), 0};
+    co_snap_t snap;
+    co_t* loaded[2];
+    const long entries = (long)sizeof(cogo_snap_head_t);
+
+    // frame out of the file
+    ASSERT_EQ(co_snap_save(path.c_str(), cos, sizes, 2), 0);
+    uint64_t off = 1 << 20;
+    patch(path, entries, &off, sizeof(off));
+    EXPECT_EQ(co_snap_load(&snap, path.c_str(), loaded, 2), -1);
+    EXPECT_EQ(errno, EINVAL);
+
+    // frame in the head
+    ASSERT_EQ(co_snap_save(path.c_str(), cos, sizes, 2), 0);
+    off = 0;
+    patch(path, entries, &off, sizeof(off));
+    EXPECT_EQ(co_snap_load(&snap, path.c_str(), loaded, 2), -1);
+    EXPECT_EQ(errno, EINVAL);
+
+    // frame size out of the file
+    ASSERT_EQ(co_snap_save(path.c_str(), cos, sizes, 2), 0);
+    uint64_t size = 1 << 20;
+    patch(path, entries + (long)offsetof(cogo_snap_entry_t, size), &size, sizeof(size));
+    EXPECT_EQ(co_snap_load(&snap, path.c_str(), loaded, 2), -1);
+    EXPECT_EQ(errno, EINVAL);
+
+    // caller out of the file
+    ASSERT_EQ(co_snap_save(path.c_str(), cos, sizes, 2), 0);
+    cogo_snap_entry_t entry;
+    FILE* f = fopen(path.c_str(), "rb");
+    ASSERT_NE(f, nullptr);
+    ASSERT_EQ(fseek(f, entries + (long)sizeof(entry), SEEK_SET), 0);
+    ASSERT_EQ(fread(&entry, sizeof(entry), 1, f), 1u);
+    fclose(f);
+    uint64_t caller = 1 << 20;
+    patch(path, (long)entry.off + (long)offsetof(cogo_co_t, caller), &caller, sizeof(caller));
+    EXPECT_EQ(co_snap_load(&snap, path.c_str(), loaded, 2), -1);
+    EXPECT_EQ(errno, EINVAL);
+
+    // entries longer than the file
+    ASSERT_EQ(co_snap_save(path.c_str(), cos, sizes, 2), 0);
+    uint32_t n = 1000;
+    patch(path, (long)offsetof(cogo_snap_head_t, n), &n, sizeof(n));
+    std::vector<co_t*> many(n);
+    EXPECT_EQ(co_snap_load(&snap, path.c_str(), many.data(), n), -1);
+    EXPECT_EQ(errno, EINVAL);
+}
+
+// run by Snap.Exec in a new process of this binary, skipped otherwise
+TEST(Snap, Resume)
+{
+    const char* path = getenv("COGO_SNAP_TEST_RESUME");
+    if (!path) {
+        GTEST_SKIP();
+    }
+    co_snap_t snap;
+    co_t* loaded[2];
+    ASSERT_EQ(co_snap_load(&snap, path, loaded, 2), 0);
+    auto* session = (Session*)loaded[0];
+    EXPECT_EQ(((cogo_co_t*)loaded[1])->func, Counter_func);
+    co_run(loaded[1]);
+    EXPECT_EQ(session->result, 110);
+    co_snap_close(&snap);
+}
+
+// resume in another process, where the binary may be loaded at another address
+TEST(Snap, Exec)
+{
+    const std::string path = testing::TempDir() + "co_snap_test_exec.snap";
+    auto session = CO_MAKE(Session, CO_MAKE(Counter));
+    co_sch_t sch = {};
+    sch.cogo_sch.stack_top = (cogo_co_t*)&session;
+    for (int i = 0; i < 4; i++) {
+        co_sch_step(&sch);
+    }
+    co_sch_destroy(&sch);
+    co_t* cos[] = {(co_t*)&session, (co_t*)&session.counter};
+    size_t sizes[] = {sizeof(session), 0};
+    ASSERT_EQ(co_snap_save(path.c_str(), cos, sizes, 2), 0);
+
+    pid_t pid = fork();
+    ASSERT_GE(pid, 0);
+    if (pid == 0) {
+        setenv("COGO_SNAP_TEST_RESUME", path.c_str(), 1);
+        execl("/proc/self/exe", "co_snap_test", "--gtest_filter=Snap.Resume", (char*)NULL);
+        _exit(127);
+    }
+    int status;
+    ASSERT_EQ(waitpid(pid, &status, 0), pid);
+    ASSERT_TRUE(WIFEXITED(status));
+    EXPECT_EQ(WEXITSTATUS(status), 0);
+}
@@ -1,6 +1,34 @@
 #include "co_st.h"
+// the hooks of COGO_PROFILE and COGO_WATCHDOG are always defined
+#include "co_prof.h"
+#include "co_watchdog.h"
 
 extern inline cogo_co_t* cogo_sch_step(cogo_sch_t* sch);
+extern inline void cogo_sch_frame_pop(cogo_sch_t* sch, cogo_co_t* co);
+extern inline int cogo_sch_ready(cogo_sch_t* sch, cogo_co_t* co);
+extern inline size_t cogo_prof_hash(uintptr_t h);
+extern inline uint64_t cogo_prof_now(void);
+extern inline void cogo_prof_call(cogo_sch_t* sch);
+extern inline uint64_t cogo_watchdog_clock(void);
+extern inline uint64_t cogo_watchdog_now(void);
+extern inline void cogo_watchdog_call(cogo_sch_t* sch);
+
+extern inline bool co_queue_empty(const co_queue_t* thiz);
+extern inline void* co_queue_pop(co_queue_t* thiz, ptrdiff_t next);
+extern inline void co_queue_push(co_queue_t* thiz, ptrdiff_t next, void* node);
+
+extern inline int co_sch_fifo_push(cogo_sch_t* sch, cogo_co_t* co);
+extern inline cogo_co_t* co_sch_fifo_pop(cogo_sch_t* sch);
+extern inline int co_sch_lifo_push(cogo_sch_t* sch, cogo_co_t* co);
+extern inline cogo_co_t* co_sch_lifo_pop(cogo_sch_t* sch);
+extern inline void cogo_sch_ring_grow(co_sch_ring_t* sch);
+extern inline int co_sch_ring_push(cogo_sch_t* sch, cogo_co_t* co);
+extern inline cogo_co_t* co_sch_ring_pop(cogo_sch_t* sch);
+extern inline size_t cogo_sch_batch_hash(void (*func)(void*));
+extern inline void cogo_sch_batch_grow(co_sch_batch_t* sch);
+extern inline cogo_sch_bucket_t* cogo_sch_batch_bucket(co_sch_batch_t* sch, void (*func)(void*));
+extern inline int co_sch_batch_push(cogo_sch_t* sch, cogo_co_t* co);
+extern inline cogo_co_t* co_sch_batch_pop(cogo_sch_t* sch);
 
 extern inline int cogo_sch_push(cogo_sch_t* sch, cogo_co_t* co);
 extern inline cogo_co_t* cogo_sch_pop(cogo_sch_t* sch);
@@ -11,10 +11,27 @@ CO_DECLARE  (NAME, ...) : ...
 CO_DEFINE   (NAME)      : ...
 CO_AWAIT    (cogo_co_t*): ...
 CO_START    (cogo_co_t*): ...
+CO_AWAIT_NEW(NAME, ...) : ...
+CO_AWAITED  (NAME)      : ...
 
 co_t                                    : coroutine type to be inherited
 co_run          (co_t*)                 : run the coroutine until all finished
 
+co_sch_t                                : scheduler type, round robin
+co_sch_init     (co_sch_t*)             : init a scheduler
+co_sch_destroy  (co_sch_t*)             : release the memory of a scheduler, driven by co_sch_run() or co_sch_step()
+co_sch_step     (co_sch_t*)             : run the scheduler a step, see cogo_sch_step()
+co_sch_run      (co_sch_t*)             : run coroutines, park when idle, until co_sch_stop() called, GCC or Clang only
+co_sch_post     (co_sch_t*, co_t*)      : add a coroutine to the scheduler, *thread-safe*, GCC or Clang only
+co_sch_stop     (co_sch_t*)             : let co_sch_run() return when idle, *thread-safe*, GCC or Clang only
+co_sch_lifo_step/run (co_sch_t*)        : the same scheduler, run the latest pushed first, e.g. await-only tasks
+
+co_sch_ring_t                           : scheduler by an array, prefetch the frames to be run, for many coroutines
+co_sch_batch_t                          : scheduler running coroutines of the same function back-to-back
+co_sch_ring_init/destroy/step/run       : ... of co_sch_ring_t, post and stop by &ring.sch
+co_sch_batch_init/destroy/step/run      : ... of co_sch_batch_t, post and stop by &batch.sch
+CO_SCH_DEFINE(NAME, TYPE, PUSH, POP)    : define NAME_step() and NAME_run() of another policy over TYPE
+
 co_msg_t                                : channel message type
 co_chan_t                               : channel type
 CO_CHAN_MAKE (size_t)                   : return a channel with capacity size_t
@@ -26,9 +43,11 @@ CO_CHAN_READ (co_chan_t*, co_msg_t*)    : receive a message from channel, the re
 #define MOXITREL_COGO_CO_IMPL_H_
 
 #include "co.h"
+#include "co_futex.h"
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <stdlib.h>
 
 typedef struct {
     void* head;
@@ -37,13 +56,13 @@ typedef struct {
 
 #define CO_QUEUE_NEXT(Q,N)    (*(void**)((intptr_t)(Q) + (N)))
 
-static inline bool co_queue_empty(const co_queue_t* thiz)
+inline bool co_queue_empty(const co_queue_t* thiz)
 {
     return thiz->head == NULL;
 }
 
 /* dequeue */
-static inline void* co_queue_pop(co_queue_t* thiz, ptrdiff_t next)
+inline void* co_queue_pop(co_queue_t* thiz, ptrdiff_t next)
 {
     void* node = thiz->head;
     if (!co_queue_empty(thiz)) {
@@ -53,7 +72,7 @@ static inline void* co_queue_pop(co_queue_t* thiz, ptrdiff_t next)
 }
 
 /* enqueue */
-static inline void co_queue_push(co_queue_t* thiz, ptrdiff_t next, void* node)
+inline void co_queue_push(co_queue_t* thiz, ptrdiff_t next, void* node)
 {
     if (co_queue_empty(thiz)) {
         thiz->head = node;
@@ -76,15 +95,85 @@ struct co {
     co_t* next;
 };
 
+// coroutines of the same function, co_sch_batch_t
+typedef struct cogo_sch_bucket {
+    void (*func)(void*);
+    // linked by co_t.next
+    co_queue_t q;
+    // in the ready list, or the current bucket
+    int ready;
+    // ready list
+    struct cogo_sch_bucket* next;
+} cogo_sch_bucket_t;
+
+// round robin, or LIFO by co_sch_lifo_step()
 struct co_sch {
     // inherent cogo_sch_t
     cogo_sch_t cogo_sch;
     // coroutine queue run concurrently
     co_queue_t q;
+
+    // coroutines posted by other threads, intrusive MPSC queue (Dmitry Vyukov), linked by co_t.next
+    struct {
+        // consumer side
+        co_t* head;
+        // producer side, atomic
+        co_t* tail;
+        co_t stub;
+        // futex word, 1 if co_sch_run() is parked, atomic
+        int parked;
+        // co_sch_stop() called, atomic
+        int stop;
+    } inbox;
 };
 
-// implement cogo_sch_push()
-inline int cogo_sch_push(cogo_sch_t* sch, cogo_co_t* co)
+// round robin by an array, prefetch the frames to be run, for many coroutines
+typedef struct {
+    // inherit co_sch_t
+    co_sch_t sch;
+    // run queue, grown by power of 2
+    struct {
+        cogo_co_t** buf;
+        size_t mask;
+        size_t head;
+        size_t tail;
+    } ring;
+} co_sch_ring_t;
+
+// run coroutines of the same function back-to-back, for many different ones
+typedef struct {
+    // inherit co_sch_t
+    co_sch_t sch;
+    // run queue
+    struct {
+        // hash table of buckets by func, grown by power of 2
+        cogo_sch_bucket_t** table;
+        size_t mask;
+        size_t n;
+        // non-empty buckets, round robin, linked by cogo_sch_bucket_t.next
+        co_queue_t ready;
+        // the bucket being drained, and coroutines popped from it
+        cogo_sch_bucket_t* cur;
+        unsigned burst;
+    } batch;
+} co_sch_batch_t;
+
+// initial capacity of co_sch_ring_t, power of 2
+#ifndef COGO_SCH_RING_SIZE
+#   define COGO_SCH_RING_SIZE       64
+#endif
+
+// co_sch_ring_t prefetches the frame popped COGO_SCH_RING_PREFETCH steps later
+#ifndef COGO_SCH_RING_PREFETCH
+#   define COGO_SCH_RING_PREFETCH   4
+#endif
+
+// co_sch_batch_t runs at most COGO_SCH_BATCH_BURST coroutines of a function before others
+#ifndef COGO_SCH_BATCH_BURST
+#   define COGO_SCH_BATCH_BURST     64
+#endif
+
+inline int co_sch_fifo_push(cogo_sch_t* sch, cogo_co_t* co)
 {
     COGO_ASSERT(sch);
     COGO_ASSERT(co);
@@ -92,13 +181,181 @@ inline int cogo_sch_push(cogo_sch_t* sch, cogo_co_t* co)
     return 1;   // switch context
 }
 
-// implement cogo_sch_pop()
-inline cogo_co_t* cogo_sch_pop(cogo_sch_t* sch)
+inline cogo_co_t* co_sch_fifo_pop(cogo_sch_t* sch)
 {
     COGO_ASSERT(sch);
     return (cogo_co_t*)co_queue_pop(&((co_sch_t*)sch)->q, offsetof(co_t, next));
 }
 
+inline int co_sch_lifo_push(cogo_sch_t* sch, cogo_co_t* co)
+{
+    COGO_ASSERT(sch);
+    COGO_ASSERT(co);
+    co_queue_t* q = &((co_sch_t*)sch)->q;
+    ((co_t*)co)->next = (co_t*)q->head;
+    q->head = co;
+    return 1;   // switch context
+}
+
+inline cogo_co_t* co_sch_lifo_pop(cogo_sch_t* sch)
+{
+    return co_sch_fifo_pop(sch);
+}
+
+// double the ring, entries moved to the beginning
+inline void cogo_sch_ring_grow(co_sch_ring_t* sch)
+{
+    size_t n = sch->ring.tail - sch->ring.head;
+    size_t cap = sch->ring.buf ? (sch->ring.mask + 1) * 2 : COGO_SCH_RING_SIZE;
+    cogo_co_t** buf = (cogo_co_t**)malloc(cap * sizeof(*buf));
+    if (!buf) {
+        abort();    // out of memory, can't be reported by the push
+    }
+    for (size_t i = 0; i < n; i++) {
+        buf[i] = sch->ring.buf[(sch->ring.head + i) & sch->ring.mask];
+    }
+    free(sch->ring.buf);
+    sch->ring.buf = buf;
+    sch->ring.mask = cap - 1;
+    sch->ring.head = 0;
+    sch->ring.tail = n;
+}
+
+inline int co_sch_ring_push(cogo_sch_t* sch, cogo_co_t* co)
+{
+    COGO_ASSERT(sch);
+    COGO_ASSERT(co);
+    co_sch_ring_t* thiz = (co_sch_ring_t*)sch;
+    if (!thiz->ring.buf || thiz->ring.tail - thiz->ring.head > thiz->ring.mask) {
+        cogo_sch_ring_grow(thiz);
+    }
+    thiz->ring.buf[thiz->ring.tail++ & thiz->ring.mask] = co;
+    return 1;   // switch context
+}
+
+// No dependent load on the popped frame as co_sch_fifo_pop() does (co_t.next).
+inline cogo_co_t* co_sch_ring_pop(cogo_sch_t* sch)
+{
+    COGO_ASSERT(sch);
+    co_sch_ring_t* thiz = (co_sch_ring_t*)sch;
+    if (thiz->ring.head == thiz->ring.tail) {
+        return NULL;
+    }
+    cogo_co_t* co = thiz->ring.buf[thiz->ring.head++ & thiz->ring.mask];
+#if defined(__GNUC__)
+    if (thiz->ring.tail - thiz->ring.head >= COGO_SCH_RING_PREFETCH) {
+        __builtin_prefetch(thiz->ring.buf[(thiz->ring.head + COGO_SCH_RING_PREFETCH - 1) & thiz->ring.mask], 1);
+    }
+#endif
+    return co;
+}
+
+inline size_t cogo_sch_batch_hash(void (*func)(void*))
+{
+    uintptr_t h = (uintptr_t)func;
+    h ^= h >> 17;
+    h *= (uintptr_t)0x9E3779B97F4A7C15ull;
+    return (size_t)(h ^ (h >> 29));
+}
+
+// double the table, keep it at most half full
+inline void cogo_sch_batch_grow(co_sch_batch_t* sch)
+{
+    size_t cap = sch->batch.table ? (sch->batch.mask + 1) * 2 : 16;
+    cogo_sch_bucket_t** table = (cogo_sch_bucket_t**)calloc(cap, sizeof(*table));
+    if (!table) {
+        abort();    // out of memory, can't be reported by the push
+    }
+    for (size_t i = 0; sch->batch.table && i <= sch->batch.mask; i++) {
+        cogo_sch_bucket_t* b = sch->batch.table[i];
+        if (b) {
+            size_t j = cogo_sch_batch_hash(b->func);
+            while (table[j & (cap - 1)]) {
+                j++;
+            }
+            table[j & (cap - 1)] = b;
+        }
+    }
+    free(sch->batch.table);
+    sch->batch.table = table;
+    sch->batch.mask = cap - 1;
+}
+
+inline cogo_sch_bucket_t* cogo_sch_batch_bucket(co_sch_batch_t* sch, void (*func)(void*))
+{
+    if (!sch->batch.table || (sch->batch.n + 1) * 2 > sch->batch.mask + 1) {
+        cogo_sch_batch_grow(sch);
+    }
+    size_t i = cogo_sch_batch_hash(func);
+    for (;; i++) {
+        cogo_sch_bucket_t* b = sch->batch.table[i & sch->batch.mask];
+        if (!b) {
+            break;
+        }
+        if (b->func == func) {
+            return b;
+        }
+    }
+    cogo_sch_bucket_t* b = (cogo_sch_bucket_t*)calloc(1, sizeof(*b));
+    if (!b) {
+        abort();
+    }
+    b->func = func;
+    sch->batch.table[i & sch->batch.mask] = b;
+    sch->batch.n++;
+    return b;
+}
+
+inline int co_sch_batch_push(cogo_sch_t* sch, cogo_co_t* co)
+{
+    COGO_ASSERT(sch);
+    COGO_ASSERT(co);
+    co_sch_batch_t* thiz = (co_sch_batch_t*)sch;
+    cogo_sch_bucket_t* b = cogo_sch_batch_bucket(thiz, co->func);
+    co_queue_push(&b->q, offsetof(co_t, next), (co_t*)co);
+    if (!b->ready) {
+        b->ready = 1;
+        co_queue_push(&thiz->batch.ready, offsetof(cogo_sch_bucket_t, next), b);
+    }
+    return 1;   // switch context
+}
+
+// Drain the current bucket, switch to the next one if empty or COGO_SCH_BATCH_BURST reached.
+inline cogo_co_t* co_sch_batch_pop(cogo_sch_t* sch)
+{
+    COGO_ASSERT(sch);
+    co_sch_batch_t* thiz = (co_sch_batch_t*)sch;
+    cogo_sch_bucket_t* b = thiz->batch.cur;
+    if (!b || co_queue_empty(&b->q) || thiz->batch.burst >= COGO_SCH_BATCH_BURST) {
+        if (b) {
+            if (co_queue_empty(&b->q)) {
+                b->ready = 0;
+            } else {
+                co_queue_push(&thiz->batch.ready, offsetof(cogo_sch_bucket_t, next), b);
+            }
+        }
+        b = thiz->batch.cur = (cogo_sch_bucket_t*)co_queue_pop(&thiz->batch.ready, offsetof(cogo_sch_bucket_t, next));
+        thiz->batch.burst = 0;
+        if (!b) {
+            return NULL;
+        }
+    }
+    thiz->batch.burst++;
+    return (cogo_co_t*)co_queue_pop(&b->q, offsetof(co_t, next));
+}
+
+// implement cogo_sch_push(), round robin for cogo_sch_step()
+inline int cogo_sch_push(cogo_sch_t* sch, cogo_co_t* co)
+{
+    return co_sch_fifo_push(sch, co);
+}
+
+// implement cogo_sch_pop()
+inline cogo_co_t* cogo_sch_pop(cogo_sch_t* sch)
+{
+    return co_sch_fifo_pop(sch);
+}
+
 static inline void co_run(void* co)
 {
     co_sch_t sch = {
@@ -108,8 +365,195 @@ static inline void co_run(void* co)
     };
     while (cogo_sch_step((cogo_sch_t*)&sch))
     {}
+    cogo_sch_frame_free((cogo_sch_t*)&sch);
+}
+
+static inline void co_sch_init(co_sch_t* sch)
+{
+    COGO_ASSERT(sch);
+    *sch = (co_sch_t){
+        .inbox = {
+            .head = &sch->inbox.stub,
+            .tail = &sch->inbox.stub,
+        },
+    };
+}
+
+// release the frame stack, the scheduler can be inited again
+static inline void co_sch_destroy(co_sch_t* sch)
+{
+    COGO_ASSERT(sch);
+    cogo_sch_frame_free((cogo_sch_t*)sch);
+}
+
+static inline void co_sch_ring_init(co_sch_ring_t* sch)
+{
+    COGO_ASSERT(sch);
+    *sch = (co_sch_ring_t){0};
+    co_sch_init(&sch->sch);
+}
+
+// release the frame stack and the ring
+static inline void co_sch_ring_destroy(co_sch_ring_t* sch)
+{
+    COGO_ASSERT(sch);
+    co_sch_destroy(&sch->sch);
+    free(sch->ring.buf);
+    sch->ring.buf = NULL;
+    sch->ring.mask = 0;
+    sch->ring.head = 0;
+    sch->ring.tail = 0;
 }
 
+static inline void co_sch_batch_init(co_sch_batch_t* sch)
+{
+    COGO_ASSERT(sch);
+    *sch = (co_sch_batch_t){0};
+    co_sch_init(&sch->sch);
+}
+
+// release the frame stack and the buckets
+static inline void co_sch_batch_destroy(co_sch_batch_t* sch)
+{
+    COGO_ASSERT(sch);
+    co_sch_destroy(&sch->sch);
+    for (size_t i = 0; sch->batch.table && i <= sch->batch.mask; i++) {
+        free(sch->batch.table[i]);
+    }
+    free(sch->batch.table);
+    sch->batch.table = NULL;
+    sch->batch.mask = 0;
+    sch->batch.n = 0;
+    sch->batch.ready = (co_queue_t){NULL, NULL};
+    sch->batch.cur = NULL;
+    sch->batch.burst = 0;
+}
+
+// posting between threads by __atomic builtins, GCC or Clang only
+#if defined(__GNUC__)
+
+static inline void cogo_sch_inbox_push(co_sch_t* sch, co_t* co)
+{
+    __atomic_store_n(&co->next, NULL, __ATOMIC_RELAXED);
+    co_t* prev = __atomic_exchange_n(&sch->inbox.tail, co, __ATOMIC_SEQ_CST);
+    // the queue is broken between exchange and store, see cogo_sch_inbox_pop().
+    __atomic_store_n(&prev->next, co, __ATOMIC_RELEASE);
+}
+
+// NULL if empty, or a producer is in the middle of push
+static inline co_t* cogo_sch_inbox_pop(co_sch_t* sch)
+{
+    co_t* head = sch->inbox.head;
+    co_t* next = __atomic_load_n(&head->next, __ATOMIC_ACQUIRE);
+    if (head == &sch->inbox.stub) {
+        if (!next) {
+            return NULL;
+        }
+        sch->inbox.head = head = next;
+        next = __atomic_load_n(&head->next, __ATOMIC_ACQUIRE);
+    }
+    if (next) {
+        sch->inbox.head = next;
+        return head;
+    }
+    if (head != __atomic_load_n(&sch->inbox.tail, __ATOMIC_ACQUIRE)) {
+        return NULL;
+    }
+    // head is the last one, put stub back to take it off
+    cogo_sch_inbox_push(sch, &sch->inbox.stub);
+    next = __atomic_load_n(&head->next, __ATOMIC_ACQUIRE);
+    if (next) {
+        sch->inbox.head = next;
+        return head;
+    }
+    return NULL;
+}
+
+static inline bool cogo_sch_inbox_empty(co_sch_t* sch)
+{
+    return __atomic_load_n(&sch->inbox.tail, __ATOMIC_SEQ_CST) == &sch->inbox.stub;
+}
+
+// One atomic exchange if the scheduler isn't parked.
+static inline void co_sch_post(co_sch_t* sch, void* co)
+{
+    COGO_ASSERT(sch);
+    COGO_ASSERT(co);
+    cogo_sch_inbox_push(sch, (co_t*)co);
+    if (__atomic_load_n(&sch->inbox.parked, __ATOMIC_SEQ_CST)
+    &&  __atomic_exchange_n(&sch->inbox.parked, 0, __ATOMIC_SEQ_CST)) {
+        cogo_futex_wake(&sch->inbox.parked, 1, 0);
+    }
+}
+
+static inline void co_sch_stop(co_sch_t* sch)
+{
+    COGO_ASSERT(sch);
+    __atomic_store_n(&sch->inbox.stop, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_exchange_n(&sch->inbox.parked, 0, __ATOMIC_SEQ_CST)) {
+        cogo_futex_wake(&sch->inbox.parked, 1, 0);
+    }
+}
+
+// "void RUN(TYPE*)" of CO_SCH_DEFINE()
+#define COGO_SCH_RUN_DEFINE(RUN, STEP, TYPE, PUSH, POP)                             \
+static inline void RUN(TYPE* thiz)                                                  \
+{                                                                                   \
+    COGO_ASSERT(thiz);                                                              \
+    co_sch_t* sch = (co_sch_t*)thiz;                                                \
+    COGO_ASSERT(sch->inbox.head);   /* init called */                               \
+                                                                                    \
+    for (;;) {                                                                      \
+        /* move posted coroutines to the run queue */                               \
+        if (!cogo_sch_inbox_empty(sch)) {                                           \
+            co_t* co;                                                               \
+            while ((co = cogo_sch_inbox_pop(sch)) != NULL) {                        \
+                PUSH((cogo_sch_t*)sch, (cogo_co_t*)co);                             \
+            }                                                                       \
+        }                                                                           \
+        if (!sch->cogo_sch.stack_top) {                                             \
+            sch->cogo_sch.stack_top = POP((cogo_sch_t*)sch);                        \
+        }                                                                           \
+        if (sch->cogo_sch.stack_top) {                                              \
+            STEP((cogo_sch_t*)sch);                                                 \
+            continue;                                                               \
+        }                                                                           \
+                                                                                    \
+        /* idle, the inbox may be seen empty by a push in progress, stop only if it's done */  \
+        if (__atomic_load_n(&sch->inbox.stop, __ATOMIC_SEQ_CST) && cogo_sch_inbox_empty(sch)) { \
+            break;                                                                  \
+        }                                                                           \
+        __atomic_store_n(&sch->inbox.parked, 1, __ATOMIC_SEQ_CST);                  \
+        if (cogo_sch_inbox_empty(sch) && !__atomic_load_n(&sch->inbox.stop, __ATOMIC_SEQ_CST)) { \
+            cogo_futex_wait(&sch->inbox.parked, 1, 0);                              \
+        }                                                                           \
+        __atomic_store_n(&sch->inbox.parked, 0, __ATOMIC_RELAXED);                  \
+    }                                                                               \
+}
+
+#else
+#   define COGO_SCH_RUN_DEFINE(RUN, STEP, TYPE, PUSH, POP)
+#endif  // __GNUC__
+
+// CO_SCH_DEFINE(NAME, TYPE, PUSH, POP): define a scheduler policy over TYPE (co_sch_t or a type inheriting it),
+// the push and pop chosen at compile time and inlined in the step loop, no dispatch on each step:
+//   cogo_co_t* NAME_step(TYPE*) : run the scheduler a step, like cogo_sch_step()
+//   void       NAME_run (TYPE*) : run coroutines, park when idle, until co_sch_stop() called, GCC or Clang only
+//
+// e.g. CO_SCH_DEFINE(my_sch, co_sch_t, my_push, my_pop)
+#define CO_SCH_DEFINE(NAME, TYPE, PUSH, POP)                                        \
+static inline COGO_SCH_STEP_DEFINE(cogo_##NAME##_step, PUSH, POP)                   \
+static inline cogo_co_t* NAME##_step(TYPE* sch)                                     \
+{                                                                                   \
+    return cogo_##NAME##_step((cogo_sch_t*)sch);                                    \
+}                                                                                   \
+COGO_SCH_RUN_DEFINE(NAME##_run, cogo_##NAME##_step, TYPE, PUSH, POP)
+
+CO_SCH_DEFINE(co_sch,       co_sch_t,       co_sch_fifo_push,   co_sch_fifo_pop)
+CO_SCH_DEFINE(co_sch_lifo,  co_sch_t,       co_sch_lifo_push,   co_sch_lifo_pop)
+CO_SCH_DEFINE(co_sch_ring,  co_sch_ring_t,  co_sch_ring_push,   co_sch_ring_pop)
+CO_SCH_DEFINE(co_sch_batch, co_sch_batch_t, co_sch_batch_push,  co_sch_batch_pop)
+
 // channel message
 struct co_msg {
     co_msg_t* next;
@@ -155,7 +599,7 @@ inline int cogo_chan_read(co_t* co, co_chan_t* chan, co_msg_t* msg_next)
         // wake up a writer if exists
         if (chan_size >= chan->cap) {
             cogo_co_t* writer = (cogo_co_t*)co_queue_pop(&chan->cq, offsetof(co_t, next));
-            return cogo_sch_push(((cogo_co_t*)co)->sch, writer);
+            return cogo_sch_ready(((cogo_co_t*)co)->sch, writer);
         }
         return 0;
     }
@@ -180,7 +624,7 @@ inline int cogo_chan_write(co_t* co, co_chan_t* chan, co_msg_t* msg)
         ((co_msg_t*)co_queue_pop(&chan->mq, offsetof(co_msg_t, next)))->next = msg;
         // wake up a reader
         cogo_co_t* reader = (cogo_co_t*)co_queue_pop(&chan->cq, offsetof(co_t, next));
-        return cogo_sch_push(((cogo_co_t*)co)->sch, reader);
+        return cogo_sch_ready(((cogo_co_t*)co)->sch, reader);
     } else {
         co_queue_push(&chan->mq, offsetof(co_msg_t, next), msg);
         if (chan_size >= chan->cap) {
@@ -204,4 +648,8 @@ inline int cogo_chan_write(co_t* co, co_chan_t* chan, co_msg_t* msg)
         __VA_ARGS__                                     \
     })
 
+#undef COGO_INIT_FUNC
+#define COGO_INIT_FUNC(NAME)                            \
+    .co.cogo_co.func = NAME##_func
+
 #endif  // MOXITREL_COGO_CO_IMPL_H_
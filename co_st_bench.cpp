@@ -0,0 +1,173 @@
+// Scheduler policies with many coroutines.
+// - steps per second of co_sch_t (linked by co_t.next) vs co_sch_ring_t (array)
+// - IPC of co_sch_t vs co_sch_batch_t with different coroutine functions interleaved
+// usage: co_st_bench [frame bytes]
+#include "co_st.h"
+#include <algorithm>
+#include <chrono>
+#include <linux/perf_event.h>
+#include <random>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <vector>
+
+static const int kYields = 16;
+
+CO_DECLARE(static Loop, int i)
+{
+CO_BEGIN:
+
+    while (((Loop*)CO_THIS)->i++ < kYields) {
+        CO_YIELD;
+    }
+
+CO_END:;
+}
+
+// the scheduler of each policy, run by SCH::run()
+struct Fifo {
+    co_sch_t sch;
+    Fifo() { co_sch_init(&sch); }
+    ~Fifo() { co_sch_destroy(&sch); }
+    co_sch_t* base() { return &sch; }
+    void run() { co_sch_run(&sch); }
+};
+
+struct Ring {
+    co_sch_ring_t sch;
+    Ring() { co_sch_ring_init(&sch); }
+    ~Ring() { co_sch_ring_destroy(&sch); }
+    co_sch_t* base() { return &sch.sch; }
+    void run() { co_sch_ring_run(&sch); }
+};
+
+struct Batch {
+    co_sch_batch_t sch;
+    Batch() { co_sch_batch_init(&sch); }
+    ~Batch() { co_sch_batch_destroy(&sch); }
+    co_sch_t* base() { return &sch.sch; }
+    void run() { co_sch_batch_run(&sch); }
+};
+
+template <typename SCH>
+static void bench(const char* name, size_t n, size_t frame)
+{
+    // frames scattered in memory, not in the order they are run
+    std::vector<char> memory(n * frame);
+    std::vector<Loop*> loops(n);
+    for (size_t i = 0; i < n; i++) {
+        loops[i] = (Loop*)&memory[i * frame];
+    }
+    std::shuffle(loops.begin(), loops.end(), std::mt19937_64(42));
+
+    SCH sch;
+    for (auto* loop : loops) {
+        *loop = CO_MAKE(Loop, 0);
+        co_sch_post(sch.base(), loop);
+    }
+    co_sch_stop(sch.base());
+    auto t0 = std::chrono::steady_clock::now();
+    sch.run();
+    double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    printf("%-5s %8zu coroutines %8.1f M steps/s\n", name, n, (double)n * (kYields + 1) / s / 1e6);
+}
+
+// ~20KB branchy code per function, all of them don't fit in L1i and the branch predictor
+#define MIX(X, K)   if ((X[0] >> 3) % 5 == (K) % 5) { X[1] += X[0] ^ (K); } else { X[2] ^= X[1] + (K); } X[0] = X[0] * 5 + 1;
+#define REP4(F)     F F F F
+#define REP256(F)   REP4(REP4(REP4(REP4(F))))
+#define WORKER(N)                                   \
+CO_DECLARE(static Worker##N, uint64_t x[4], int i)  \
+{                                                   \
+    auto* thiz = (Worker##N*)CO_THIS;               \
+CO_BEGIN:                                           \
+                                                    \
+    while (thiz->i++ < kYields) {                   \
+        REP256(MIX(thiz->x, N))                     \
+        CO_YIELD;                                   \
+    }                                               \
+                                                    \
+CO_END:;                                            \
+}
+WORKER(0) WORKER(1) WORKER(2)  WORKER(3)  WORKER(4)  WORKER(5)  WORKER(6)  WORKER(7)
+WORKER(8) WORKER(9) WORKER(10) WORKER(11) WORKER(12) WORKER(13) WORKER(14) WORKER(15)
+
+// same layout for all workers
+typedef Worker0 Worker;
+static void (*const kWorkers[])(void*) = {
+    Worker0_func, Worker1_func, Worker2_func,  Worker3_func,  Worker4_func,  Worker5_func,  Worker6_func,  Worker7_func,
+    Worker8_func, Worker9_func, Worker10_func, Worker11_func, Worker12_func, Worker13_func, Worker14_func, Worker15_func,
+};
+
+// user space hardware counter of this thread, -1 if not permitted
+static int perf_open(uint64_t config)
+{
+    struct perf_event_attr attr = {};
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = config;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static uint64_t perf_read(int fd)
+{
+    uint64_t v = 0;
+    if (fd < 0 || read(fd, &v, sizeof(v)) != sizeof(v)) {
+        return 0;
+    }
+    return v;
+}
+
+template <typename SCH>
+static void bench_batch(const char* name, size_t n)
+{
+    std::vector<Worker> workers(n);
+    SCH sch;
+    for (size_t i = 0; i < n; i++) {
+        workers[i] = CO_MAKE(Worker0, {i});
+        workers[i].co.cogo_co.func = kWorkers[i % (sizeof(kWorkers) / sizeof(kWorkers[0]))];
+        co_sch_post(sch.base(), &workers[i]);
+    }
+    co_sch_stop(sch.base());
+
+    int instructions = perf_open(PERF_COUNT_HW_INSTRUCTIONS);
+    int cycles = perf_open(PERF_COUNT_HW_CPU_CYCLES);
+    uint64_t i0 = perf_read(instructions);
+    uint64_t c0 = perf_read(cycles);
+    auto t0 = std::chrono::steady_clock::now();
+    sch.run();
+    double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    uint64_t i1 = perf_read(instructions);
+    uint64_t c1 = perf_read(cycles);
+    printf("%-5s %8zu coroutines %8.2f M steps/s", name, n, (double)n * (kYields + 1) / s / 1e6);
+    if (c1 > c0) {
+        printf("  IPC %.2f", (double)(i1 - i0) / (double)(c1 - c0));
+    }
+    printf("\n");
+    if (instructions >= 0) {
+        close(instructions);
+    }
+    if (cycles >= 0) {
+        close(cycles);
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    size_t frame = argc > 1 ? (size_t)atol(argv[1]) : 256;
+    frame = std::max(frame, sizeof(Loop) + alignof(Loop) - 1) / alignof(Loop) * alignof(Loop);
+    for (size_t n = 1 << 10; n <= 1 << 20; n <<= 2) {
+        bench<Fifo>("fifo", n, frame);
+        bench<Ring>("ring", n, frame);
+    }
+    for (size_t n = 1 << 10; n <= 1 << 16; n <<= 3) {
+        bench_batch<Fifo>("fifo", n);
+        bench_batch<Batch>("batch", n);
+    }
+    return 0;
+}
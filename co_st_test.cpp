@@ -1,6 +1,10 @@
 #include <assert.h>
 #include "co_st.h"
 #include "gtest/gtest.h"
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
 
 CO_DECLARE(static Recv, co_chan_t* c, co_msg_t msgNext)
 {
@@ -39,3 +43,238 @@ TEST(Chan, ReadWrite)
     co_run(&entry);
     EXPECT_EQ(&entry.send1.msg, entry.recv1.msgNext.next);
 }
+
+CO_DECLARE(static Count, int* n)
+{
+CO_BEGIN:
+
+    ++*((Count*)CO_THIS)->n;
+    CO_YIELD;
+    ++*((Count*)CO_THIS)->n;
+
+CO_END:;
+}
+
+CO_DECLARE(static Stop, co_sch_t* sch)
+{
+CO_BEGIN:
+
+    co_sch_stop(((Stop*)CO_THIS)->sch);
+
+CO_END:;
+}
+
+TEST(Sch, Post)
+{
+    co_sch_t sch;
+    co_sch_init(&sch);
+    int n = 0;
+    std::vector<Count> counts(1000, CO_MAKE(Count, &n));
+    auto stop = CO_MAKE(Stop, &sch);
+
+    std::thread runner(co_sch_run, &sch);
+    for (size_t i = 0; i < counts.size(); i++) {
+        co_sch_post(&sch, &counts[i]);
+        if (i % 100 == 0) {
+            // let the scheduler park
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+    co_sch_post(&sch, &stop);
+    runner.join();
+    co_sch_destroy(&sch);
+    EXPECT_EQ(n, 2000);
+}
+
+TEST(Sch, PostMultiThread)
+{
+    co_sch_t sch;
+    co_sch_init(&sch);
+    int n = 0;
+    std::vector<Count> counts(4 * 10000, CO_MAKE(Count, &n));
+
+    std::thread runner(co_sch_run, &sch);
+    std::vector<std::thread> posters;
+    for (size_t t = 0; t < 4; t++) {
+        posters.emplace_back([&, t] {
+            for (size_t i = t * 10000; i < (t + 1) * 10000; i++) {
+                co_sch_post(&sch, &counts[i]);
+            }
+        });
+    }
+    for (auto& poster : posters) {
+        poster.join();
+    }
+    co_sch_stop(&sch);
+    runner.join();
+    co_sch_destroy(&sch);
+    EXPECT_EQ(n, 2 * 4 * 10000);
+}
+
+CO_DECLARE(static Log, std::string* log, char c)
+{
+CO_BEGIN:
+
+    *((Log*)CO_THIS)->log += ((Log*)CO_THIS)->c;
+
+CO_END:;
+}
+
+CO_DECLARE(static Spawn, Log a, Log b, co_sch_t* sch)
+{
+CO_BEGIN:
+
+    CO_START(&((Spawn*)CO_THIS)->a);
+    CO_START(&((Spawn*)CO_THIS)->b);
+    co_sch_stop(((Spawn*)CO_THIS)->sch);
+
+CO_END:;
+}
+
+// the policy of RUN is used by CO_START too
+template <typename T>
+static std::string spawn_log(T* sch, co_sch_t* base, void (*run)(T*))
+{
+    std::string log;
+    auto spawn = CO_MAKE(Spawn, CO_MAKE(Log, &log, 'a'), CO_MAKE(Log, &log, 'b'), base);
+    co_sch_post(base, &spawn);
+    run(sch);
+    return log;
+}
+
+TEST(Sch, Policy)
+{
+    co_sch_t sch;
+    co_sch_init(&sch);
+    EXPECT_EQ(spawn_log(&sch, &sch, co_sch_run), "ab");
+    co_sch_destroy(&sch);
+
+    co_sch_init(&sch);
+    EXPECT_EQ(spawn_log(&sch, &sch, co_sch_lifo_run), "ba");
+    co_sch_destroy(&sch);
+
+    co_sch_ring_t ring;
+    co_sch_ring_init(&ring);
+    EXPECT_EQ(spawn_log(&ring, &ring.sch, co_sch_ring_run), "ab");
+    co_sch_ring_destroy(&ring);
+
+    co_sch_batch_t batch;
+    co_sch_batch_init(&batch);
+    EXPECT_EQ(spawn_log(&batch, &batch.sch, co_sch_batch_run), "ab");
+    co_sch_batch_destroy(&batch);
+}
+
+TEST(Sch, RingGrow)
+{
+    int n = 0;
+    std::vector<Count> counts(1000, CO_MAKE(Count, &n));
+    co_sch_ring_t sch;
+    co_sch_ring_init(&sch);
+    for (auto& count : counts) {
+        co_sch_post(&sch.sch, &count);
+    }
+    co_sch_stop(&sch.sch);
+    co_sch_ring_run(&sch);
+    EXPECT_EQ(n, 2 * 1000);
+    EXPECT_GT(sch.ring.mask + 1, 1000u);   // grown
+    co_sch_ring_destroy(&sch);
+    EXPECT_EQ(sch.ring.buf, nullptr);
+}
+
+CO_DECLARE(static Upper, std::string* log, char c)
+{
+CO_BEGIN:
+
+    *((Upper*)CO_THIS)->log += (char)toupper(((Upper*)CO_THIS)->c);
+
+CO_END:;
+}
+
+TEST(Sch, Batch)
+{
+    std::string log;
+    std::vector<Log> logs;
+    for (char c : std::string("abcd")) {
+        logs.push_back(CO_MAKE(Log, &log, c));
+    }
+    std::vector<Upper> uppers;
+    for (char c : std::string("xy")) {
+        uppers.push_back(CO_MAKE(Upper, &log, c));
+    }
+    co_sch_batch_t sch;
+    co_sch_batch_init(&sch);
+    co_sch_post(&sch.sch, &logs[0]);
+    co_sch_post(&sch.sch, &uppers[0]);
+    co_sch_post(&sch.sch, &logs[1]);
+    co_sch_post(&sch.sch, &uppers[1]);
+    co_sch_post(&sch.sch, &logs[2]);
+    co_sch_post(&sch.sch, &logs[3]);
+    co_sch_stop(&sch.sch);
+    co_sch_batch_run(&sch);
+    co_sch_batch_destroy(&sch);
+    EXPECT_EQ(log, "abcdXY");   // grouped by function
+}
+
+TEST(Sch, BatchBurst)
+{
+    std::string log;
+    std::vector<Log> logs(COGO_SCH_BATCH_BURST + 1, CO_MAKE(Log, &log, 'a'));
+    auto upper = CO_MAKE(Upper, &log, 'x');
+    co_sch_batch_t sch;
+    co_sch_batch_init(&sch);
+    for (auto& l : logs) {
+        co_sch_post(&sch.sch, &l);
+    }
+    co_sch_post(&sch.sch, &upper);
+    co_sch_stop(&sch.sch);
+    co_sch_batch_run(&sch);
+    co_sch_batch_destroy(&sch);
+    EXPECT_EQ(log.find('X'), (size_t)COGO_SCH_BATCH_BURST);  // not starved
+    EXPECT_EQ(log.size(), logs.size() + 1);
+}
+
+CO_DECLARE(static Big, Entry entry, char buf[8192], int n)
+{
+CO_BEGIN:
+
+    CO_AWAIT(&((Big*)CO_THIS)->entry);
+    ((Big*)CO_THIS)->n = ((Big*)CO_THIS)->buf[0];
+
+CO_END:;
+}
+
+CO_FRAME_BUDGET(Big, 8192 + 256);
+
+TEST(Init, InPlace)
+{
+    static_assert(CO_FRAME_SIZE(Big) >= 8192, "");
+    auto c0 = CO_CHAN_MAKE(0);
+    auto* big = (Big*)malloc(sizeof(Big));
+    memset(big, 0xff, sizeof(Big));     // garbage
+
+    CO_INIT(big, Big,
+            .buf[0] = 3,
+            CO_CHILD(entry, Entry,
+                     CO_CHILD(recv1, Recv, .c = &c0),
+                     CO_CHILD(send1, Send, .c = &c0)));
+    EXPECT_EQ(CO_STATE(big), 0);
+    EXPECT_EQ(big->entry.recv1.c, &c0);
+    EXPECT_EQ(big->entry.send1.msg.next, nullptr);  // zeroed
+    EXPECT_EQ(big->buf[1], 0);
+
+    co_run(big);
+    EXPECT_EQ(CO_STATE(big), -1);
+    EXPECT_EQ(&big->entry.send1.msg, big->entry.recv1.msgNext.next);
+    EXPECT_EQ(big->n, 3);
+    free(big);
+}
+
+TEST(Init, NoArgs)
+{
+    int n = 0;
+    Count count;
+    CO_INIT(&count, Count);
+    count.n = &n;
+    co_run(&count);
+    EXPECT_EQ(n, 2);
+}
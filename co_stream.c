@@ -0,0 +1,4 @@
+#include "co_stream.h"
+
+extern inline int cogo_stream_reserve(co_t* co, co_stream_t* s, size_t n, char** pspan);
+extern inline int cogo_stream_read(co_t* co, co_stream_t* s, size_t n, const char** pspan, bool consume);
@@ -0,0 +1,215 @@
+/*
+
+* API
+co_stream_t                                                 : byte stream type, over a buffer
+CO_STREAM_MAKE      (char*, size_t)                         : return a stream over a buffer of size_t bytes
+CO_STREAM_RESERVE   (co_stream_t*, size_t, char**)          : park until size_t bytes free in a row, span to write stored in char**,
+                                                              or NULL if closed
+co_stream_commit    (co_stream_t*, size_t)                  : publish size_t bytes written into the reserved span, the next ones
+                                                              by the next commit
+co_stream_close     (co_stream_t*)                          : no more bytes, wake up all readers and writers
+CO_STREAM_READ_EXACT(co_stream_t*, size_t, const char**)    : park until size_t bytes available, consume them,
+                                                              span stored in const char**, or NULL if closed before
+CO_STREAM_PEEK      (co_stream_t*, size_t, const char**)    : ditto, not consumed
+co_stream_size      (co_stream_t*)                          : bytes available
+
+* Example
+CO_DECLARE(Decode, co_stream_t* s, const char* span, uint32_t len)
+{
+    Decode* thiz = (Decode*)CO_THIS;
+CO_BEGIN:
+
+    for (;;) {
+        CO_STREAM_READ_EXACT(thiz->s, 4, &thiz->span);      // length prefix
+        if (!thiz->span) {
+            break;                                          // closed
+        }
+        memcpy(&thiz->len, thiz->span, 4);
+        CO_STREAM_READ_EXACT(thiz->s, thiz->len, &thiz->span);
+        ...                                                 // the frame in place, [span, span + len)
+    }
+
+CO_END:;
+}
+
+* Note
+- A read span points into the buffer, it's valid until the coroutine yields or calls the stream again.
+- A reserved span is valid until fully committed, or reserved again by the same coroutine (the rest dropped).
+  One reservation at a time, other writers park until it's committed.
+- Bytes are in a row in the buffer, the unread ones are moved to the front when a reserve doesn't fit at the end,
+  i.e. only the partial frame left is copied.
+- A reader/writer is resumed only when its size_t bytes are ready. size_t must not exceed the buffer size.
+
+*/
+#ifndef MOXITREL_COGO_CO_STREAM_H_
+#define MOXITREL_COGO_CO_STREAM_H_
+
+#include "co_st.h"
+#include <string.h>
+
+typedef struct {
+    // buffer, bytes [rpos, wpos) to be read, [wpos, rend) reserved
+    char* const buf;
+    const size_t cap;
+    size_t rpos;
+    size_t wpos;
+    size_t rend;
+    // the coroutine holding the reservation, NULL if none
+    co_t* writer;
+    // co_stream_close() called
+    bool closed;
+    // readers blocked by this stream, and the min bytes they wait for, 0 if none
+    co_queue_t rq;
+    size_t rneed;
+    // writers blocked by this stream, and the min bytes they wait for, 0 if none
+    co_queue_t wq;
+    size_t wneed;
+} co_stream_t;
+
+#define CO_STREAM_MAKE(BUF, N)   ((co_stream_t){.buf = (BUF), .cap = (N),})
+
+static inline size_t co_stream_size(const co_stream_t* s)
+{
+    COGO_ASSERT(s);
+    return s->wpos - s->rpos;
+}
+
+// resume all waiters of a side, they check their sizes again
+static inline void cogo_stream_wake(co_queue_t* q, size_t* need)
+{
+    cogo_sch_t* sch = ((cogo_co_t*)q->head)->sch;
+    co_t* co;
+    while ((co = (co_t*)co_queue_pop(q, offsetof(co_t, next))) != NULL) {
+        cogo_sch_ready(sch, (cogo_co_t*)co);
+    }
+    *need = 0;
+}
+
+static inline void cogo_stream_park(co_queue_t* q, size_t* need, co_t* co, size_t n)
+{
+    co_queue_push(q, offsetof(co_t, next), co);
+    if (*need == 0 || n < *need) {
+        *need = n;
+    }
+    ((cogo_co_t*)co)->sch->stack_top = NULL;    // remove from scheduler
+}
+
+static inline void co_stream_commit(co_stream_t* s, size_t n)
+{
+    COGO_ASSERT(s);
+    COGO_ASSERT(n <= s->rend - s->wpos);
+
+    s->wpos += n;
+    if (s->wpos == s->rend) {
+        // fully committed, let the parked writers reserve
+        s->writer = NULL;
+        if (s->wneed) {
+            cogo_stream_wake(&s->wq, &s->wneed);
+        }
+    }
+    if (s->rneed && s->wpos - s->rpos >= s->rneed) {
+        cogo_stream_wake(&s->rq, &s->rneed);
+    }
+}
+
+static inline void co_stream_close(co_stream_t* s)
+{
+    COGO_ASSERT(s);
+    s->closed = true;
+    if (s->rneed) {
+        cogo_stream_wake(&s->rq, &s->rneed);
+    }
+    if (s->wneed) {
+        cogo_stream_wake(&s->wq, &s->wneed);
+    }
+}
+
+// CO_STREAM_RESERVE(co_stream_t*, size_t, char**);
+#define CO_STREAM_RESERVE(S, N, PSPAN)                                                              \
+do {                                                                                                \
+    while (cogo_stream_reserve((co_t*)(CO_THIS), (S), (N), (PSPAN)) != 0) {                         \
+        CO_YIELD;                                                                                   \
+    }                                                                                               \
+} while (0)
+// return !0 if blocked, should be retried when resumed
+inline int cogo_stream_reserve(co_t* co, co_stream_t* s, size_t n, char** pspan)
+{
+//  COGO_ASSERT(co);
+    COGO_ASSERT(s);
+    COGO_ASSERT(n <= s->cap);
+    COGO_ASSERT(pspan);
+
+    if (s->closed) {
+        *pspan = NULL;
+        return 0;
+    }
+    if (s->rend != s->wpos && s->writer != co) {
+        // reserved by another writer
+        cogo_stream_park(&s->wq, &s->wneed, co, n);
+        return 1;
+    }
+    // drop the rest of our reservation
+    s->rend = s->wpos;
+    if (n > s->cap - s->wpos) {
+        if (n > s->cap - (s->wpos - s->rpos)) {
+            s->writer = NULL;
+            cogo_stream_park(&s->wq, &s->wneed, co, n);
+            return 1;
+        }
+        // move the unread bytes to the front
+        memmove(s->buf, s->buf + s->rpos, s->wpos - s->rpos);
+        s->wpos -= s->rpos;
+        s->rpos = 0;
+    }
+    *pspan = s->buf + s->wpos;
+    s->rend = s->wpos + n;
+    s->writer = n ? co : NULL;
+    return 0;
+}
+
+// CO_STREAM_READ_EXACT(co_stream_t*, size_t, const char**);
+#define CO_STREAM_READ_EXACT(S, N, PSPAN)                                                           \
+do {                                                                                                \
+    while (cogo_stream_read((co_t*)(CO_THIS), (S), (N), (PSPAN), true) != 0) {                      \
+        CO_YIELD;                                                                                   \
+    }                                                                                               \
+} while (0)
+
+// CO_STREAM_PEEK(co_stream_t*, size_t, const char**);
+#define CO_STREAM_PEEK(S, N, PSPAN)                                                                 \
+do {                                                                                                \
+    while (cogo_stream_read((co_t*)(CO_THIS), (S), (N), (PSPAN), false) != 0) {                     \
+        CO_YIELD;                                                                                   \
+    }                                                                                               \
+} while (0)
+// return !0 if blocked, should be retried when resumed
+inline int cogo_stream_read(co_t* co, co_stream_t* s, size_t n, const char** pspan, bool consume)
+{
+//  COGO_ASSERT(co);
+    COGO_ASSERT(s);
+    COGO_ASSERT(n <= s->cap);
+    COGO_ASSERT(pspan);
+
+    if (s->wpos - s->rpos < n) {
+        if (s->closed) {
+            *pspan = NULL;
+            return 0;
+        }
+        cogo_stream_park(&s->rq, &s->rneed, co, n);
+        return 1;
+    }
+    *pspan = s->buf + s->rpos;
+    if (consume) {
+        s->rpos += n;
+        if (s->rpos == s->wpos && s->rend == s->wpos) {
+            // empty and not reserved, the bytes stay in place until the next reserve
+            s->rpos = s->wpos = s->rend = 0;
+        }
+        if (s->wneed && s->cap - (s->wpos - s->rpos) >= s->wneed) {
+            cogo_stream_wake(&s->wq, &s->wneed);
+        }
+    }
+    return 0;
+}
+
+#endif // MOXITREL_COGO_CO_STREAM_H_
@@ -0,0 +1,276 @@
+#include "co_stream.h"
+#include "gtest/gtest.h"
+#include <string>
+#include <vector>
+
+// write length-prefixed frames, a few bytes per step
+CO_DECLARE(static Encode, co_stream_t* s, std::vector<std::string>* frames, size_t i, std::string wire, size_t off, size_t n, char* span)
+{
+    auto* thiz = (Encode*)CO_THIS;
+    uint32_t len;
+CO_BEGIN:
+
+    for (thiz->i = 0; thiz->i < thiz->frames->size(); thiz->i++) {
+        len = (uint32_t)(*thiz->frames)[thiz->i].size();
+        thiz->wire.assign((const char*)&len, 4);
+        thiz->wire += (*thiz->frames)[thiz->i];
+        for (thiz->off = 0; thiz->off < thiz->wire.size(); thiz->off += thiz->n) {
+            thiz->n = thiz->wire.size() - thiz->off < 3 ? thiz->wire.size() - thiz->off : 3;
+            CO_STREAM_RESERVE(thiz->s, thiz->n, &thiz->span);
+            memcpy(thiz->span, thiz->wire.data() + thiz->off, thiz->n);
+            co_stream_commit(thiz->s, thiz->n);
+            CO_YIELD;
+        }
+    }
+    co_stream_close(thiz->s);
+
+CO_END:;
+}
+
+CO_DECLARE(static Decode, co_stream_t* s, std::vector<std::string>* frames, const char* span, uint32_t len, int resumed)
+{
+    auto* thiz = (Decode*)CO_THIS;
+CO_BEGIN:
+
+    for (;;) {
+        CO_STREAM_READ_EXACT(thiz->s, 4, &thiz->span);
+        if (!thiz->span) {
+            break;
+        }
+        memcpy(&thiz->len, thiz->span, 4);
+        CO_STREAM_READ_EXACT(thiz->s, thiz->len, &thiz->span);
+        if (!thiz->span) {
+            break;
+        }
+        thiz->frames->emplace_back(thiz->span, thiz->len);
+        thiz->resumed++;
+    }
+
+CO_END:;
+}
+
+CO_DECLARE(static Entry, Decode decode, Encode encode)
+{
+    auto* thiz = (Entry*)CO_THIS;
+CO_BEGIN:
+
+    CO_START(&thiz->decode);
+    CO_START(&thiz->encode);
+
+CO_END:;
+}
+
+TEST(Stream, Frames)
+{
+    std::vector<std::string> in = {"hello", "", "a frame longer than a reserve", "x", "0123456789"};
+    std::vector<std::string> out;
+    char buf[40];
+    auto s = CO_STREAM_MAKE(buf, sizeof(buf));
+    auto entry = CO_MAKE(Entry, CO_MAKE(Decode, &s, &out), CO_MAKE(Encode, &s, &in));
+    co_run(&entry);
+
+    EXPECT_EQ(out, in);
+    EXPECT_EQ(entry.decode.resumed, (int)in.size());
+    EXPECT_EQ(co_stream_size(&s), 0u);
+}
+
+// the writer parks while the buffer full
+TEST(Stream, Backpressure)
+{
+    std::vector<std::string> in(20, std::string(12, 'z'));
+    std::vector<std::string> out;
+    char buf[16];
+    auto s = CO_STREAM_MAKE(buf, sizeof(buf));
+    auto entry = CO_MAKE(Entry, CO_MAKE(Decode, &s, &out), CO_MAKE(Encode, &s, &in));
+    co_run(&entry);
+
+    EXPECT_EQ(out, in);
+}
+
+CO_DECLARE(static Peek, co_stream_t* s, const char* peeked, const char* read, size_t left)
+{
+    auto* thiz = (Peek*)CO_THIS;
+CO_BEGIN:
+
+    CO_STREAM_PEEK(thiz->s, 3, &thiz->peeked);
+    thiz->left = co_stream_size(thiz->s);
+    CO_STREAM_READ_EXACT(thiz->s, 3, &thiz->read);
+
+CO_END:;
+}
+
+CO_DECLARE(static Feed, co_stream_t* s, char* span)
+{
+    auto* thiz = (Feed*)CO_THIS;
+CO_BEGIN:
+
+    CO_STREAM_RESERVE(thiz->s, 4, &thiz->span);
+    memcpy(thiz->span, "abcd", 4);
+    co_stream_commit(thiz->s, 2);   // not enough for the peek
+    CO_YIELD;
+    co_stream_commit(thiz->s, 2);
+
+CO_END:;
+}
+
+CO_DECLARE(static PeekEntry, Peek peek, Feed feed)
+{
+    auto* thiz = (PeekEntry*)CO_THIS;
+CO_BEGIN:
+
+    CO_START(&thiz->peek);
+    CO_START(&thiz->feed);
+
+CO_END:;
+}
+
+TEST(Stream, Peek)
+{
+    char buf[8];
+    auto s = CO_STREAM_MAKE(buf, sizeof(buf));
+    auto entry = CO_MAKE(PeekEntry, CO_MAKE(Peek, &s), CO_MAKE(Feed, &s));
+    co_run(&entry);
+
+    EXPECT_EQ(entry.peek.left, 4u);
+    EXPECT_EQ(entry.peek.peeked, buf);
+    EXPECT_EQ(entry.peek.read, buf);
+    EXPECT_EQ(std::string(entry.peek.read, 3), "abc");
+    EXPECT_EQ(co_stream_size(&s), 1u);
+}
+
+CO_DECLARE(static ReadClosed, co_stream_t* s, const char* span)
+{
+    auto* thiz = (ReadClosed*)CO_THIS;
+CO_BEGIN:
+
+    CO_STREAM_READ_EXACT(thiz->s, 4, &thiz->span);
+
+CO_END:;
+}
+
+TEST(Stream, Closed)
+{
+    char buf[8] = "ab";
+    auto s = CO_STREAM_MAKE(buf, sizeof(buf));
+    co_stream_commit(&s, 2);
+    co_stream_close(&s);
+    auto co = CO_MAKE(ReadClosed, &s, buf);
+    co_run(&co);
+
+    EXPECT_EQ(co.span, nullptr);
+    EXPECT_EQ(co_stream_size(&s), 2u);
+}
+
+CO_DECLARE(static ReadPairs, co_stream_t* s, const char* span, std::string got)
+{
+    auto* thiz = (ReadPairs*)CO_THIS;
+CO_BEGIN:
+
+    CO_STREAM_READ_EXACT(thiz->s, 2, &thiz->span);
+    thiz->got.append(thiz->span, 2);
+    CO_STREAM_READ_EXACT(thiz->s, 2, &thiz->span);
+    thiz->got.append(thiz->span, 2);
+
+CO_END:;
+}
+
+CO_DECLARE(static PartialEntry, ReadPairs read, Feed feed)
+{
+    auto* thiz = (PartialEntry*)CO_THIS;
+CO_BEGIN:
+
+    CO_START(&thiz->read);
+    CO_START(&thiz->feed);
+
+CO_END:;
+}
+
+// drained between commits of a reservation, the rest stays in place
+TEST(Stream, PartialCommit)
+{
+    char buf[8];
+    auto s = CO_STREAM_MAKE(buf, sizeof(buf));
+    auto entry = CO_MAKE(PartialEntry, CO_MAKE(ReadPairs, &s), CO_MAKE(Feed, &s));
+    co_run(&entry);
+
+    EXPECT_EQ(entry.read.got, "abcd");
+    EXPECT_EQ(co_stream_size(&s), 0u);
+}
+
+// reserve, yield, commit
+CO_DECLARE(static Put, co_stream_t* s, const char* text, char* span)
+{
+    auto* thiz = (Put*)CO_THIS;
+CO_BEGIN:
+
+    CO_STREAM_RESERVE(thiz->s, 2, &thiz->span);
+    if (thiz->span) {
+        memcpy(thiz->span, thiz->text, 2);
+        CO_YIELD;
+        CO_YIELD;   // let the other writer reserve
+        co_stream_commit(thiz->s, 2);
+    }
+
+CO_END:;
+}
+
+CO_DECLARE(static PutEntry, Put a, Put b, ReadPairs read)
+{
+    auto* thiz = (PutEntry*)CO_THIS;
+CO_BEGIN:
+
+    CO_START(&thiz->a);
+    CO_START(&thiz->b);
+    CO_START(&thiz->read);
+
+CO_END:;
+}
+
+// the second writer parks until the first reservation committed
+TEST(Stream, TwoWriters)
+{
+    char buf[8];
+    auto s = CO_STREAM_MAKE(buf, sizeof(buf));
+    auto entry = CO_MAKE(PutEntry, CO_MAKE(Put, &s, "ab"), CO_MAKE(Put, &s, "cd"), CO_MAKE(ReadPairs, &s));
+    co_run(&entry);
+
+    EXPECT_EQ(entry.read.got, "abcd");
+}
+
+CO_DECLARE(static Closer, co_stream_t* s)
+{
+    auto* thiz = (Closer*)CO_THIS;
+CO_BEGIN:
+
+    CO_YIELD;
+    co_stream_close(thiz->s);
+
+CO_END:;
+}
+
+CO_DECLARE(static CloseEntry, Put put, Closer closer)
+{
+    auto* thiz = (CloseEntry*)CO_THIS;
+CO_BEGIN:
+
+    CO_START(&thiz->put);
+    CO_START(&thiz->closer);
+
+CO_END:;
+}
+
+// a writer parked on a full stream is woken by close
+TEST(Stream, CloseWakesWriter)
+{
+    char buf[2];
+    auto s = CO_STREAM_MAKE(buf, sizeof(buf));
+    auto first = CO_MAKE(Put, &s, "xy");
+    co_run(&first);     // fill it
+    ASSERT_EQ(co_stream_size(&s), 2u);
+
+    auto entry = CO_MAKE(CloseEntry, CO_MAKE(Put, &s, "zz"), CO_MAKE(Closer, &s));
+    co_run(&entry);
+
+    EXPECT_EQ(CO_STATE(&entry.put), -1);
+    EXPECT_EQ(entry.put.span, nullptr);
+}
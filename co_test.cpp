@@ -30,6 +30,7 @@ static void cogo_co_run(void* co)
     };
     while (cogo_sch_step(&sch))
     {}
+    cogo_sch_frame_free(&sch);
 }
 
 CO_DECLARE(static F3)
@@ -156,3 +157,156 @@ TEST(cogo_co_t, Run)
         ASSERT_EQ(example[i].fib.v, example[i].value);
     }
 }
+
+CO_DECLARE(static FibonacciNew, unsigned n, unsigned v)
+{
+    auto* thiz = (FibonacciNew*)CO_THIS;
+    auto& n = thiz->n;
+    auto& v = thiz->v;
+CO_BEGIN:
+
+    if (n <= 1) {
+        v = 1;
+        CO_RETURN;
+    }
+    // children on the frame stack, no malloc()
+    CO_AWAIT_NEW(FibonacciNew, .n = n - 1);
+    v = CO_AWAITED(FibonacciNew)->v;
+    CO_AWAIT_NEW(FibonacciNew, .n = n - 2);
+    v += CO_AWAITED(FibonacciNew)->v;
+
+CO_END:;
+}
+
+TEST(cogo_co_t, AwaitNew)
+{
+    for (unsigned n : {0u, 1u, 11u, 23u}) {
+        auto fib = CO_MAKE(FibonacciNew, n);
+        cogo_co_run(&fib);
+        ASSERT_EQ(fib.v, fibonacci(n));
+    }
+}
+
+CO_DECLARE(static Big, char buf[3000], Big* child, int depth)
+{
+    auto* thiz = (Big*)CO_THIS;
+CO_BEGIN:
+
+    // deep enough to span several segments
+    if (thiz->depth > 0) {
+        CO_AWAIT_NEW(Big, .depth = thiz->depth - 1);
+        CO_YIELD;
+    }
+
+CO_END:;
+}
+
+TEST(cogo_co_t, AwaitNewSegments)
+{
+    auto big = CO_MAKE(Big, .depth = 64);
+    cogo_sch_t sch = {
+        .stack_top = (cogo_co_t*)&big,
+    };
+    while (cogo_sch_step(&sch))
+    {}
+    EXPECT_EQ(CO_STATE(&big), -1);
+    EXPECT_EQ(sch.frame.top, nullptr);
+    EXPECT_EQ(sch.frame.seg, nullptr);
+    EXPECT_NE(sch.frame.spare, nullptr);
+    cogo_sch_frame_free(&sch);
+}
+
+TEST(cogo_co_t, AwaitNewWarm)
+{
+    cogo_sch_t sch = {};
+    auto fib = CO_MAKE(FibonacciNew, 11);
+    sch.stack_top = (cogo_co_t*)&fib;
+    while (cogo_sch_step(&sch))
+    {}
+    cogo_frame_seg_t* warm = sch.frame.spare;
+    ASSERT_NE(warm, nullptr);
+
+    // no new segment after warm-up
+    fib = CO_MAKE(FibonacciNew, 11);
+    sch.stack_top = (cogo_co_t*)&fib;
+    while (cogo_sch_step(&sch)) {
+        ASSERT_TRUE(sch.frame.seg == nullptr || sch.frame.seg == warm);
+    }
+    EXPECT_EQ(sch.frame.spare, warm);
+    EXPECT_EQ(fib.v, fibonacci(11));
+    cogo_sch_frame_free(&sch);
+}
+
+CO_DECLARE(static Leaf, int v)
+{
+CO_BEGIN:
+
+    ((Leaf*)CO_THIS)->v = 1;
+
+CO_END:;
+}
+
+// the fields before leaf lie where a frame header of leaf would be
+CO_DECLARE(static Mid, intptr_t a, intptr_t b, Leaf leaf)
+{
+    auto* thiz = (Mid*)CO_THIS;
+CO_BEGIN:
+
+    CO_AWAIT(&thiz->leaf);
+
+CO_END:;
+}
+
+CO_DECLARE(static Top, intptr_t a, intptr_t b, int v)
+{
+    auto* thiz = (Top*)CO_THIS;
+CO_BEGIN:
+
+    CO_AWAIT_NEW(Mid, .a = -1, .b = -2, CO_CHILD(leaf, Leaf));
+    thiz->a = CO_AWAITED(Mid)->a;
+    thiz->b = CO_AWAITED(Mid)->b;
+    thiz->v = CO_AWAITED(Mid)->leaf.v;
+
+CO_END:;
+}
+
+TEST(cogo_co_t, AwaitNewEmbedded)
+{
+    auto top = CO_MAKE(Top, 0);
+    cogo_sch_t sch = {
+        .stack_top = (cogo_co_t*)&top,
+    };
+    while (cogo_sch_step(&sch))
+    {}
+    EXPECT_EQ(top.a, -1);
+    EXPECT_EQ(top.b, -2);
+    EXPECT_EQ(top.v, 1);
+    EXPECT_EQ(sch.frame.top, nullptr);
+    cogo_sch_frame_free(&sch);
+}
+
+// another policy in the same binary: a yielded coroutine runs again at once
+static int again_push(cogo_sch_t* sch, cogo_co_t* co)
+{
+    sch->stack_top = co;
+    return 1;
+}
+
+static cogo_co_t* again_pop(cogo_sch_t* sch)
+{
+    return sch->stack_top;
+}
+
+static inline COGO_SCH_STEP_DEFINE(again_step, again_push, again_pop)
+
+TEST(cogo_co_t, StepDefine)
+{
+    auto fib = CO_MAKE(FibonacciNew, 11);
+    cogo_sch_t sch = {
+        .stack_top = (cogo_co_t*)&fib,
+    };
+    while (again_step(&sch))
+    {}
+    cogo_sch_frame_free(&sch);
+    EXPECT_EQ(fib.v, fibonacci(11));
+}
@@ -0,0 +1,159 @@
+/* Slow-step watchdog, enabled by defining COGO_WATCHDOG (for the whole program, see the CMake option), included by co.h.
+
+* API
+cogo_watchdog_t                                         : watchdog data, attached to a scheduler by cogo_sch_t.watchdog
+cogo_watchdog_init(cogo_watchdog_t*, uint64_t, cb, arg) : reset, report steps longer than uint64_t nanoseconds
+cogo_watchdog_entry_t                                   : a slow step, passed to cb(const cogo_watchdog_entry_t*, arg)
+
+* Example
+    static void report(const cogo_watchdog_entry_t* e, void* arg)
+    {
+        fprintf(stderr, "%p: func %p resumed at line %d, took %llu ns\n", e->co, (void*)e->func, e->state, e->ns);
+    }
+
+    cogo_watchdog_t watchdog;
+    cogo_watchdog_init(&watchdog, 1000000, report, NULL);  // 1 ms
+    sch.watchdog = &watchdog;
+    ...                                                     // run the scheduler
+    watchdog.log[i % COGO_WATCHDOG_LOG]                     // the last COGO_WATCHDOG_LOG ones, i < watchdog.count
+
+* Note
+- A step is a call of the stack top's func by cogo_sch_step(), i.e. until the coroutine yields, awaits or finishes.
+- The step is timed by the CPU cycle counter (rdtsc, cntvct_el0), or clock_gettime() on other platforms.
+  It's calibrated in about 1 ms by the first cogo_watchdog_init() (once per file including it, normally once per
+  process). Define COGO_WATCHDOG_NOW() (for the whole program) to use another clock, in nanoseconds, or ticks of
+  COGO_WATCHDOG_TICKS_PER_NS, nothing calibrated.
+- The coroutine may be finished and freed when the entry is reported, only its address is recorded.
+- The type of coroutine is told by func (NAME_func), e.g. by dladdr() or addr2line.
+- Composes with COGO_PROFILE, the watchdog times the profiled call.
+
+*/
+#ifndef MOXITREL_COGO_CO_WATCHDOG_H_
+#define MOXITREL_COGO_CO_WATCHDOG_H_
+
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+// max slow steps kept in cogo_watchdog_t.log
+#ifndef COGO_WATCHDOG_LOG
+#   define COGO_WATCHDOG_LOG    64
+#endif
+
+// read the cycle counter, may be defined to another clock, e.g. a fake one in tests
+#ifndef COGO_WATCHDOG_NOW
+#   define COGO_WATCHDOG_NOW()  cogo_watchdog_now()
+#   ifndef COGO_WATCHDOG_TICKS_PER_NS
+#       define COGO_WATCHDOG_TICKS_PER_NS   cogo_watchdog_calibrate()
+#   endif
+#endif
+
+// ticks of COGO_WATCHDOG_NOW() per nanosecond, 1 for a clock defined by user unless defined too
+#ifndef COGO_WATCHDOG_TICKS_PER_NS
+#   define COGO_WATCHDOG_TICKS_PER_NS       1.0
+#endif
+
+typedef struct {
+    // the coroutine, and its function
+    cogo_co_t* co;
+    void (*func)(void*);
+    // CO_STATE() when entered, i.e. the line resumed from, 0 if started
+    int state;
+    // duration
+    unsigned long long ns;
+} cogo_watchdog_entry_t;
+
+struct cogo_watchdog {
+    // threshold in counter ticks
+    uint64_t threshold;
+    // counter ticks per nanosecond
+    double ticks_per_ns;
+    // called on each slow step, may be NULL
+    void (*callback)(const cogo_watchdog_entry_t*, void*);
+    void* arg;
+    // slow steps ever seen, the last COGO_WATCHDOG_LOG ones kept in log[count % COGO_WATCHDOG_LOG]
+    uint64_t count;
+    cogo_watchdog_entry_t log[COGO_WATCHDOG_LOG];
+};
+
+inline uint64_t cogo_watchdog_clock(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+// cycle counter
+inline uint64_t cogo_watchdog_now(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __builtin_ia32_rdtsc();
+#elif defined(__aarch64__)
+    uint64_t v;
+    __asm__ __volatile__("mrs %0, cntvct_el0" : "=r"(v));
+    return v;
+#else
+    return cogo_watchdog_clock();
+#endif
+}
+
+// ticks of cogo_watchdog_now() per nanosecond, measured in about 1 ms by the first call
+static inline double cogo_watchdog_calibrate(void)
+{
+    static double ticks_per_ns;     // threads racing on the first call measure it more than once
+    double v;
+    __atomic_load(&ticks_per_ns, &v, __ATOMIC_RELAXED);
+    if (v == 0) {
+        uint64_t c0 = cogo_watchdog_now();
+        uint64_t t0 = cogo_watchdog_clock();
+        uint64_t t1;
+        while ((t1 = cogo_watchdog_clock()) - t0 < 1000000)
+        {}
+        uint64_t c1 = cogo_watchdog_now();
+        v = c1 > c0 ? (double)(c1 - c0) / (double)(t1 - t0) : 1;
+        __atomic_store(&ticks_per_ns, &v, __ATOMIC_RELAXED);
+    }
+    return v;
+}
+
+static inline void cogo_watchdog_init(cogo_watchdog_t* wd, uint64_t threshold_ns,
+                                      void (*callback)(const cogo_watchdog_entry_t*, void*), void* arg)
+{
+    COGO_ASSERT(wd);
+    memset(wd, 0, sizeof(*wd));
+    wd->callback = callback;
+    wd->arg = arg;
+    wd->ticks_per_ns = COGO_WATCHDOG_TICKS_PER_NS;
+    wd->threshold = (uint64_t)((double)threshold_ns * wd->ticks_per_ns);
+}
+
+// COGO_SCH_CALL: run the stack top, log it if slow
+inline void cogo_watchdog_call(cogo_sch_t* sch)
+{
+    cogo_watchdog_t* wd = sch->watchdog;
+    if (!wd) {
+        COGO_SCH_CALL_PROF(sch);
+        return;
+    }
+    cogo_co_t* co = sch->stack_top;
+    void (*func)(void*) = co->func;
+    int state = CO_STATE(co);
+
+    uint64_t t0 = COGO_WATCHDOG_NOW();
+    COGO_SCH_CALL_PROF(sch);
+    uint64_t ticks = COGO_WATCHDOG_NOW() - t0;
+    if (ticks <= wd->threshold) {
+        return;
+    }
+
+    cogo_watchdog_entry_t* e = &wd->log[wd->count++ % COGO_WATCHDOG_LOG];
+    e->co = co;
+    e->func = func;
+    e->state = state;
+    e->ns = (unsigned long long)((double)ticks / wd->ticks_per_ns);
+    if (wd->callback) {
+        wd->callback(e, wd->arg);
+    }
+}
+
+#endif // MOXITREL_COGO_CO_WATCHDOG_H_
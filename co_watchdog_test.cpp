@@ -0,0 +1,153 @@
+#include <assert.h>
+#include <stdint.h>
+
+// fake clock in nanoseconds, advanced by coroutines
+static uint64_t fakeNow;
+#define COGO_WATCHDOG_NOW() fakeNow
+
+#include "co_st.h"
+#include "gtest/gtest.h"
+#include <vector>
+
+static int slowLine;
+
+CO_DECLARE(static Fast, int i)
+{
+    auto* thiz = (Fast*)CO_THIS;
+CO_BEGIN:
+
+    for (thiz->i = 0; thiz->i < 10; thiz->i++) {
+        CO_YIELD;
+    }
+
+CO_END:;
+}
+
+// hog the scheduler after resumed
+CO_DECLARE(static Slow)
+{
+CO_BEGIN:
+
+    slowLine = __LINE__ + 1;
+    CO_YIELD;
+    fakeNow += 5000000;
+
+CO_END:;
+}
+
+CO_DECLARE(static Entry, Fast fast, Slow slow)
+{
+    auto* thiz = (Entry*)CO_THIS;
+CO_BEGIN:
+
+    CO_START(&thiz->fast);
+    CO_START(&thiz->slow);
+
+CO_END:;
+}
+
+static void collect(const cogo_watchdog_entry_t* e, void* arg)
+{
+    ((std::vector<cogo_watchdog_entry_t>*)arg)->push_back(*e);
+}
+
+TEST(Watchdog, Slow)
+{
+    std::vector<cogo_watchdog_entry_t> reported;
+    cogo_watchdog_t watchdog;
+    cogo_watchdog_init(&watchdog, 2000000, collect, &reported);
+
+    auto entry = CO_MAKE(Entry, CO_MAKE(Fast), CO_MAKE(Slow));
+    co_sch_t sch = {};
+    sch.cogo_sch.stack_top = (cogo_co_t*)&entry;
+    sch.cogo_sch.watchdog = &watchdog;
+    while (co_sch_step(&sch))
+    {}
+    co_sch_destroy(&sch);
+    EXPECT_EQ(CO_STATE(&entry.slow), -1);
+
+    ASSERT_EQ(watchdog.count, 1u);
+    ASSERT_EQ(reported.size(), 1u);
+    const auto& e = watchdog.log[0];
+    EXPECT_EQ(e.co, (cogo_co_t*)&entry.slow);
+    EXPECT_EQ(e.func, Slow_func);
+    EXPECT_EQ(e.state, slowLine);
+    EXPECT_EQ(e.ns, 5000000u);
+    EXPECT_EQ(reported[0].co, e.co);
+}
+
+// step i takes i + 1 ns
+CO_DECLARE(static Steps, int i)
+{
+    auto* thiz = (Steps*)CO_THIS;
+CO_BEGIN:
+
+    for (thiz->i = 0; thiz->i < 100; thiz->i++) {
+        fakeNow += (uint64_t)thiz->i + 1;
+        CO_YIELD;
+    }
+
+CO_END:;
+}
+
+TEST(Watchdog, LogWrap)
+{
+    static_assert(COGO_WATCHDOG_LOG == 64, "");
+    cogo_watchdog_t watchdog;
+    cogo_watchdog_init(&watchdog, 0, NULL, NULL);   // every step advanced the clock
+
+    auto steps = CO_MAKE(Steps);
+    co_sch_t sch = {};
+    sch.cogo_sch.stack_top = (cogo_co_t*)&steps;
+    sch.cogo_sch.watchdog = &watchdog;
+    while (co_sch_step(&sch))
+    {}
+    co_sch_destroy(&sch);
+    ASSERT_EQ(watchdog.count, 100u);
+    // the newest 64 kept, the older ones overwritten, the first (started) included
+    for (uint64_t i = watchdog.count - COGO_WATCHDOG_LOG; i < watchdog.count; i++) {
+        EXPECT_EQ(watchdog.log[i % COGO_WATCHDOG_LOG].ns, i + 1) << i;
+        EXPECT_GT(watchdog.log[i % COGO_WATCHDOG_LOG].state, 0) << i;      // resumed
+    }
+}
+
+// a clock defined by user is in nanoseconds, the cycle counter is calibrated once
+TEST(Watchdog, Calibrate)
+{
+    cogo_watchdog_t watchdog;
+    cogo_watchdog_init(&watchdog, 1000, NULL, NULL);
+    EXPECT_EQ(watchdog.ticks_per_ns, 1.0);
+    EXPECT_EQ(watchdog.threshold, 1000u);
+
+    double ticks_per_ns = cogo_watchdog_calibrate();
+    EXPECT_GT(ticks_per_ns, 0);
+    uint64_t t0 = cogo_watchdog_clock();
+    EXPECT_EQ(cogo_watchdog_calibrate(), ticks_per_ns);
+    EXPECT_LT(cogo_watchdog_clock() - t0, 1000000u);    // not measured again
+}
+
+#ifdef COGO_PROFILE
+// both hooks on the same step
+TEST(Watchdog, Profile)
+{
+    static cogo_prof_t prof;
+    cogo_prof_init(&prof, 1);
+    cogo_watchdog_t watchdog;
+    cogo_watchdog_init(&watchdog, 2000000, NULL, NULL);
+
+    auto entry = CO_MAKE(Entry, CO_MAKE(Fast), CO_MAKE(Slow));
+    co_sch_t sch = {};
+    sch.cogo_sch.stack_top = (cogo_co_t*)&entry;
+    sch.cogo_sch.prof = &prof;
+    sch.cogo_sch.watchdog = &watchdog;
+    while (co_sch_step(&sch))
+    {}
+    co_sch_destroy(&sch);
+    EXPECT_EQ(watchdog.count, 1u);
+    uint64_t samples = 0;
+    for (const auto& s : prof.stacks) {
+        samples += s.count;
+    }
+    EXPECT_GT(samples, 11u);                        // every step sampled
+}
+#endif
@@ -86,6 +86,33 @@
 #define COGO_MAP_18(SEP, F, X, ...)   F(X) SEP COGO_MAP_17(SEP, F, __VA_ARGS__)
 #define COGO_MAP_19(SEP, F, X, ...)   F(X) SEP COGO_MAP_18(SEP, F, __VA_ARGS__)
 
+// COGO_MAPX(F, C, ...): COGO_MAP() separated by comma, with a context argument passed to F
+//e.g. COGO_MAPX(ADD, 1, 10, 20)
+//     -> ADD(1, 10), ADD(1, 20)
+#define COGO_MAPX(F, C, ...)     COGO_MAPX1(COGO_ARG_COUNT(__VA_ARGS__), F, C, __VA_ARGS__)
+#define COGO_MAPX1(...)          COGO_MAPX2(__VA_ARGS__)
+#define COGO_MAPX2(N, ...)       COGO_MAPX_##N(__VA_ARGS__)
+#define COGO_MAPX_0(...)
+#define COGO_MAPX_1( F, C, ...)       F(C, __VA_ARGS__)
+#define COGO_MAPX_2( F, C, X, ...)   F(C, X), COGO_MAPX_1( F, C, __VA_ARGS__)
+#define COGO_MAPX_3( F, C, X, ...)   F(C, X), COGO_MAPX_2( F, C, __VA_ARGS__)
+#define COGO_MAPX_4( F, C, X, ...)   F(C, X), COGO_MAPX_3( F, C, __VA_ARGS__)
+#define COGO_MAPX_5( F, C, X, ...)   F(C, X), COGO_MAPX_4( F, C, __VA_ARGS__)
+#define COGO_MAPX_6( F, C, X, ...)   F(C, X), COGO_MAPX_5( F, C, __VA_ARGS__)
+#define COGO_MAPX_7( F, C, X, ...)   F(C, X), COGO_MAPX_6( F, C, __VA_ARGS__)
+#define COGO_MAPX_8( F, C, X, ...)   F(C, X), COGO_MAPX_7( F, C, __VA_ARGS__)
+#define COGO_MAPX_9( F, C, X, ...)   F(C, X), COGO_MAPX_8( F, C, __VA_ARGS__)
+#define COGO_MAPX_10(F, C, X, ...)   F(C, X), COGO_MAPX_9( F, C, __VA_ARGS__)
+#define COGO_MAPX_11(F, C, X, ...)   F(C, X), COGO_MAPX_10(F, C, __VA_ARGS__)
+#define COGO_MAPX_12(F, C, X, ...)   F(C, X), COGO_MAPX_11(F, C, __VA_ARGS__)
+#define COGO_MAPX_13(F, C, X, ...)   F(C, X), COGO_MAPX_12(F, C, __VA_ARGS__)
+#define COGO_MAPX_14(F, C, X, ...)   F(C, X), COGO_MAPX_13(F, C, __VA_ARGS__)
+#define COGO_MAPX_15(F, C, X, ...)   F(C, X), COGO_MAPX_14(F, C, __VA_ARGS__)
+#define COGO_MAPX_16(F, C, X, ...)   F(C, X), COGO_MAPX_15(F, C, __VA_ARGS__)
+#define COGO_MAPX_17(F, C, X, ...)   F(C, X), COGO_MAPX_16(F, C, __VA_ARGS__)
+#define COGO_MAPX_18(F, C, X, ...)   F(C, X), COGO_MAPX_17(F, C, __VA_ARGS__)
+#define COGO_MAPX_19(F, C, X, ...)   F(C, X), COGO_MAPX_18(F, C, __VA_ARGS__)
+
 // COGO_IFNIL(ID)(SK,FK): Expand to <SK> if ID defined as empty, i.e. "#define ID", else FK
 #define COGO_IFNIL(...)                 COGO_IFNIL1(COGO_ARG_EMPTY(__VA_ARGS__))
 #define COGO_IFNIL1(...)                COGO_IFNIL2(__VA_ARGS__)
@@ -11,19 +11,25 @@ CO_THIS                 : the parameter name of coroutine function.
 CO_DECLARE(NAME, ...)   : declare a coroutine.
 CO_DEFINE (NAME)        : define a declared coroutine which not defined.
 CO_MAKE   (NAME, ...)   : coroutine maker.
+CO_INIT   (PTR, NAME, ...)      : make a coroutine at PTR in place, designated initializers only, e.g. .v = 1
+CO_CHILD  (FIELD, NAME, ...)    : argument of CO_INIT(), make the embedded coroutine FIELD in place
+CO_FRAME_SIZE  (NAME)           : frame size of coroutine NAME, a constant expression
+CO_FRAME_BUDGET(NAME, size_t)   : compile error if the frame of NAME is larger than size_t bytes
 NAME_func               : coroutine function name, made by CO_DECLARE(NAME), e.g. Nat_func
+cogo_resume(NAME*)      : (C++ only) call NAME_func, an overload made by CO_DECLARE(NAME), see co_range.hpp
 
 */
 #ifndef MOXITREL_COGO_YIELD_H_
 #define MOXITREL_COGO_YIELD_H_
 
-#if defined(__GNUC__)
+#if defined(__GNUC__) && !defined(COGO_CASE)
 #   include "yield_label_value.h"
 #else
 #   include "yield_case.h"
 #endif
 
 #include "utils.h"
+#include <string.h>
 
 // COGO_STRUCT(Type, T1 field1, ...): define a struct named <Type>
 //
@@ -54,11 +60,33 @@ NAME_func               : coroutine function name, made by CO_DECLARE(NAME), e.g
         COGO_MAP(;, COGO_ID, __VA_ARGS__);                                  \
     }
 
+// COGO_TYPE(NAME): the type name without linkage, e.g. COGO_TYPE(static Nat) -> Nat
+#define COGO_TYPE(NAME)                 COGO_TYPE1(COGO_ARG_COUNT(COGO_COMMA_##NAME), NAME)
+#define COGO_TYPE1(...)                 COGO_TYPE2(__VA_ARGS__)
+#define COGO_TYPE2(N, NAME)             COGO_TYPE_##N(NAME)
+#define COGO_TYPE_1(NAME)               NAME
+#define COGO_TYPE_2(NAME)               COGO_REMOVE_LINKAGE_##NAME
+#define COGO_CAT(A, B)                  COGO_CAT1(A, B)
+#define COGO_CAT1(A, B)                 A##B
+
+// COGO_RESUME_DEFINE(NAME): C++, resume a coroutine by its type, a direct call to be inlined
+#ifdef __cplusplus
+#   define COGO_RESUME_DEFINE(NAME)                                         \
+    CO_DEFINE(NAME);                                                        \
+    static inline void cogo_resume(COGO_TYPE(NAME)* co)                     \
+    {                                                                       \
+        COGO_CAT(COGO_TYPE(NAME), _func)(co);                               \
+    }
+#else
+#   define COGO_RESUME_DEFINE(NAME)     /*nop*/
+#endif
+
 #define COGO_DECLARE(NAME, BASE, ...)                                       \
     COGO_IFNIL(__VA_ARGS__)(                                                \
         COGO_STRUCT(NAME, BASE),                                            \
         COGO_STRUCT(NAME, BASE, __VA_ARGS__)                                \
     );                                                                      \
+    COGO_RESUME_DEFINE(NAME)                                                \
     CO_DEFINE(NAME)
 
 #define CO_DEFINE(NAME)                 \
@@ -73,4 +101,45 @@ NAME_func               : coroutine function name, made by CO_DECLARE(NAME), e.g
         __VA_ARGS__                     \
     })
 
+// COGO_INIT_FUNC(NAME): the designator of CO_MAKE() initializing the base, redefined by each layer
+#define COGO_INIT_FUNC(NAME)            \
+    .cogo_yield.cogo_pc = 0
+
+// CO_INIT(PTR, NAME, .field = value, ..., CO_CHILD(FIELD, CHILD, ...), ...): CO_MAKE() without copying the frame.
+// Fields not given are zeroed, PTR is evaluated once, at most 19 initializers after expanding CO_CHILD().
+//
+// e.g. Entry* entry = (Entry*)malloc(sizeof(Entry));
+//      CO_INIT(entry, Entry, .n = 1, CO_CHILD(recv, Recv, .chan = &chan));
+#define CO_INIT(PTR, NAME, ...)                                             \
+do {                                                                        \
+    NAME* cogo_init = (NAME*)(PTR);                                         \
+    memset(cogo_init, 0, sizeof(NAME));                                     \
+    (*cogo_init) COGO_INIT_FUNC(NAME);                                      \
+    COGO_IF_EMPTY(__VA_ARGS__)(COGO_NOP, COGO_INIT_REST)(cogo_init, __VA_ARGS__); \
+} while (0)
+#define COGO_NOP(...)
+// COGO_IF_EMPTY(...)(T, F): T if ... is empty, else F, which may be a macro name called by the following arguments
+#define COGO_IF_EMPTY(...)              COGO_CAT(COGO_IF_EMPTY_, COGO_ARG_EMPTY(__VA_ARGS__))
+#define COGO_IF_EMPTY_1(T, F)           T
+#define COGO_IF_EMPTY_0(T, F)           F
+#define COGO_INIT_REST(P, ...)          (COGO_MAPX(COGO_INIT_ARG, P, __VA_ARGS__))
+#define COGO_INIT_ARG(P, X)             (*(P)) X
+
+// CO_CHILD(FIELD, NAME, ...): expand to the designated initializers of the embedded coroutine, prefixed by .FIELD
+#define CO_CHILD(FIELD, NAME, ...)                                          \
+    .FIELD COGO_INIT_FUNC(NAME)                                             \
+    COGO_IF_EMPTY(__VA_ARGS__)(COGO_NOP, COGO_CHILD_REST)(FIELD, __VA_ARGS__)
+#define COGO_CHILD_REST(FIELD, ...)     , COGO_MAPX(COGO_CHILD_ARG, FIELD, __VA_ARGS__)
+#define COGO_CHILD_ARG(FIELD, X)        .FIELD X
+
+#define CO_FRAME_SIZE(NAME)             sizeof(NAME)
+
+#if defined(__cplusplus)
+#   define CO_FRAME_BUDGET(NAME, SIZE)  static_assert(sizeof(NAME) <= (SIZE), "frame of " #NAME " over budget")
+#elif defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L
+#   define CO_FRAME_BUDGET(NAME, SIZE)  _Static_assert(sizeof(NAME) <= (SIZE), "frame of " #NAME " over budget")
+#else
+#   define CO_FRAME_BUDGET(NAME, SIZE)  typedef char COGO_CAT(cogo_frame_budget_, __LINE__)[sizeof(NAME) <= (SIZE) ? 1 : -1]
+#endif
+
 #endif // MOXITREL_COGO_YIELD_H_
@@ -56,6 +56,9 @@ void nat_func(nat_t* CO_THIS)
 #   define COGO_ASSERT(...) /*nop*/
 #endif
 
+// statement run before CO_BEGIN, overridden by the profiler
+#define COGO_ON_BEGIN       /*nop*/
+
 // yield context
 typedef struct {
     // start point where coroutine function continue to run after yield.
@@ -74,6 +77,7 @@ typedef struct {
 
 
 #define CO_BEGIN                                        \
+    COGO_ON_BEGIN                                       \
     switch (COGO_PC) {                                  \
     default:                /* invalid  pc      */      \
         COGO_ASSERT(((void)"cogo_pc isn't valid",0));   \
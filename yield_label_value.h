@@ -15,22 +15,24 @@ CO_END:;
 * Internal
 void nat_func(nat_t* CO_THIS)
 {
-    if (CO_THIS->pc) {          //
-        goto *CO_THIS->pc;      // CO_BEGIN:
-    }                           //
+    goto *(&&enter + pc);       // CO_BEGIN:
+enter:                          //
 
     for (CO_THIS->i = 0; ;CO_THIS->i++) {
 
-        pc = &&yield_11;        //
-        return;                 // CO_YIELD;
-    yield_11:;                  //
+        pc = &&yield_11 - &&enter;  //
+        return;                     // CO_YIELD;
+    yield_11:;                      //
 
     }
 
-    pc = &&yield_end;           // CO_END:
+    pc = &&yield_end - &&enter; // CO_END:
 yield_end:;                     //
 }
 
+The restore point is saved as an offset from the label "enter", which is position independent,
+i.e. the coroutine object can be saved and resumed by another process of the same binary (ASLR).
+
 * Drawbacks
 - Use GCC extension.
 
@@ -38,19 +40,31 @@ yield_end:;                     //
 #ifndef MOXITREL_COGO_YIELD_IMPL_H_
 #define MOXITREL_COGO_YIELD_IMPL_H_
 
+#include <stddef.h>
+
 #ifdef assert
 #   define COGO_ASSERT(...) assert(__VA_ARGS__)
 #else
 #   define COGO_ASSERT(...) /*nop*/
 #endif
 
+// statement run before CO_BEGIN, overridden by the profiler
+#define COGO_ON_BEGIN       /*nop*/
+
+// statement keeping the line of CO_YIELD in COGO_STATE, for the profiler and the watchdog only
+#if defined(COGO_PROFILE) || defined(COGO_WATCHDOG)
+#   define COGO_YIELD_SITE  COGO_STATE = __LINE__;
+#else
+#   define COGO_YIELD_SITE  /*nop*/
+#endif
+
 // yield context
 typedef struct {
-    // start point where coroutine function continue to run after yield.
-    const void* cogo_pc;
+    // start point where coroutine function continue to run after yield, offset from label cogo_enter.
+    ptrdiff_t cogo_pc;
 
     //  0: inited
-    // >0: running
+    // >0: running, the line of the last yield (__LINE__) if COGO_PROFILE or COGO_WATCHDOG defined, else of CO_BEGIN
     // -1: finish successfully
     int cogo_state;
 } cogo_yield_t;
@@ -66,19 +80,19 @@ typedef struct {
 #define CO_STATE(CO)    (((cogo_yield_t*)(CO))->cogo_state)
 
 
-#define CO_BEGIN                        \
-    if (COGO_STATE == 0) {              \
-        COGO_PC = &&cogo_enter;         \
-        COGO_STATE = __LINE__;          \
-    }                                   \
-    goto *COGO_PC;                      \
+#define CO_BEGIN                                    \
+    COGO_ON_BEGIN                                   \
+    if (COGO_STATE == 0) {                          \
+        COGO_STATE = __LINE__;                      \
+    }                                               \
+    goto *((char*)&&cogo_enter + COGO_PC);          \
 cogo_enter
 
 
 #define CO_YIELD                                                        \
     do {                                                                \
-        COGO_PC = &&COGO_LABEL;         /* 1. save restore point */     \
-    /*  COGO_STATE = __LINE__; */                                       \
+        COGO_PC = COGO_OFFSET(COGO_LABEL);  /* 1. save restore point */ \
+        COGO_YIELD_SITE                 /*    the yield site */         \
         goto cogo_exit;                 /* 2. return */                 \
     COGO_LABEL:;                        /* 3. restore point */          \
     } while (0)
@@ -90,11 +104,14 @@ cogo_enter
 
 #define CO_END                                      \
     cogo_return:                                    \
-        COGO_PC = &&cogo_exit;                      \
+        COGO_PC = COGO_OFFSET(cogo_exit);           \
         COGO_STATE = -1;   /* finish */             \
     cogo_exit
 
 
+// offset of label from cogo_enter
+#define COGO_OFFSET(LABEL)  ((char*)&&LABEL - (char*)&&cogo_enter)
+
 // Make goto label.
 // e.g. COGO_LABEL(13)       -> cogo_yield_13
 //      COGO_LABEL(__LINE__) -> cogo_yield_118